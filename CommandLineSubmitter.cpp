@@ -0,0 +1,168 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CommandLineSubmitter.h"
+#include "Settings.h"
+
+#include <stdio.h>
+#include <string.h>
+
+CommandLineSubmitter::CommandLineSubmitter(Mode mode, QObject *p) : QObject(p), qtsOut(stdout) {
+    mMode = mode;
+    iExitCode = 0;
+    lhLogHandler = NULL;
+    qnamAccessor = NULL;
+}
+
+CommandLineSubmitter::~CommandLineSubmitter() {
+    delete lhLogHandler;
+    delete qnamAccessor;
+}
+
+// Figure out the mode to run in from the command line. Arguments other
+// than our own are left alone, as the system may pass some of its own
+// (such as -psn_ on Mac OS X). Returns None for a normal, windowed run.
+CommandLineSubmitter::Mode CommandLineSubmitter::modeForArguments(int argc, char *argv[]) {
+    Mode mode = None;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--list") == 0)
+            mode = List;
+        else if (strcmp(argv[i], "--dry-run") == 0)
+            mode = DryRun;
+        else if (strcmp(argv[i], "--submit-all") == 0 && mode != DryRun)
+            mode = SubmitAll;
+        else if (strcmp(argv[i], "--help") == 0)
+            return Usage;
+    }
+    return mode;
+}
+
+// Do what we were asked to, and return the exit status. Must be called
+// with a QCoreApplication in place, but before its event loop runs.
+int CommandLineSubmitter::run() {
+    if (mMode != List && mMode != DryRun && mMode != SubmitAll) {
+        fprintf(stderr, "Usage: %s [--list | --dry-run | --submit-all]\n"
+                        "\n"
+                        "  --list        List all crash logs, with their header fields.\n"
+                        "  --dry-run     List the crash logs a submit would upload.\n"
+                        "  --submit-all  Submit all crash logs to the server.\n"
+                        "\n"
+                        "Exit status:\n"
+                        "\n"
+                        "  0  Success.\n"
+                        "  1  A crash log failed to submit, or the submit was cancelled.\n"
+                        "  2  The submit could not be started.\n"
+                        "  3  No crash log directory was found.\n",
+                qPrintable(QCoreApplication::applicationName()));
+        return 0;
+    }
+
+    Settings::get()->apply();
+    if (LogHandler::crashLogDirectories().isEmpty()) {
+        qWarning("CommandLineSubmitter: No crash log directory found.");
+        return 3;
+    }
+    lhLogHandler = new LogHandler();
+
+    if (mMode == List) {
+        list();
+        qtsOut.flush();
+        return iExitCode;
+    }
+
+    qnamAccessor = new QNetworkAccessManager();
+    lhLogHandler->setNetworkAccessManager(qnamAccessor);
+    lhLogHandler->setDryRun(mMode == DryRun);
+    QObject::connect(lhLogHandler, SIGNAL(crashLogQueued(QString, QString)), this, SLOT(crashLogQueued(QString, QString)));
+    QObject::connect(lhLogHandler, SIGNAL(crashLogSubmitted(QString, QString, bool)), this, SLOT(crashLogSubmitted(QString, QString, bool)));
+    QObject::connect(lhLogHandler, SIGNAL(submitFinished(int, int, bool)), this, SLOT(submitFinished(int, int, bool)));
+
+    if (! lhLogHandler->startSubmittingCrashLogs()) {
+        qWarning("CommandLineSubmitter: Unable to start submitting crash logs.");
+        return 2;
+    }
+
+    QCoreApplication::exec();
+    qtsOut.flush();
+    return iExitCode;
+}
+
+// Print a line of tab-separated fields. Tabs and newlines within the
+// fields are replaced by spaces, so every line stays parseable.
+void CommandLineSubmitter::printLine(const QStringList &fields) {
+    QStringList clean;
+    foreach (QString field, fields) {
+        field.replace(QLatin1Char('\t'), QLatin1Char(' '));
+        field.replace(QLatin1Char('\n'), QLatin1Char(' '));
+        clean << field;
+    }
+    qtsOut << clean.join(QLatin1String("\t")) << endl;
+}
+
+// Print all crash logs along with their header fields. Logs that could not
+// be parsed are listed with their size only.
+void CommandLineSubmitter::list() {
+    CrashLogScan scan = lhLogHandler->scanCrashLogCatalog();
+    QStringList devices = scan.devices;
+    devices.sort();
+    foreach (QString device, devices) {
+        foreach (QString file, scan.files.value(device)) {
+            DeviceLog log(device, file);
+            QStringList fields;
+            fields << QLatin1String("log") << device << file;
+            if (scan.entries.contains(log)) {
+                const CatalogEntry &entry = scan.entries[log];
+                fields << QString::number(entry.size)
+                    << entry.version
+                    << entry.osVersion
+                    << entry.exceptionType
+                    << QDateTime::fromTime_t(entry.date).toUTC().toString(Qt::ISODate);
+            } else {
+                fields << QString::number(QFileInfo(scan.paths.value(log)).size())
+                    << QString() << QString() << QString() << QString();
+            }
+            printLine(fields);
+        }
+    }
+}
+
+void CommandLineSubmitter::crashLogQueued(const QString &deviceName, const QString &fileName) {
+    printLine(QStringList() << QLatin1String("queued") << deviceName << fileName);
+}
+
+void CommandLineSubmitter::crashLogSubmitted(const QString &deviceName, const QString &fileName, bool success) {
+    printLine(QStringList() << QLatin1String(success ? "submitted" : "failed") << deviceName << fileName);
+}
+
+void CommandLineSubmitter::submitFinished(int submittedLogs, int failedLogs, bool cancelled) {
+    printLine(QStringList() << QLatin1String("summary") << QString::number(submittedLogs) << QString::number(failedLogs));
+    if (failedLogs > 0 || cancelled)
+        iExitCode = 1;
+    QCoreApplication::exit(iExitCode);
+}
@@ -0,0 +1,80 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __COMMANDLINESUBMITTER_H__
+#define __COMMANDLINESUBMITTER_H__
+
+#include <QtCore/QtCore>
+#include <QtNetwork/QtNetwork>
+
+#include "LogHandler.h"
+
+// Runs the crash reporter without its window, for scripting it on build
+// and test machines. Only a LogHandler and a plain network access manager
+// are set up; there is no web page, cookie jar or domain list.
+//
+// Results are printed to stdout as tab-separated lines, each starting
+// with what the line is about:
+//
+//   log <device> <file> <size> <version> <osVersion> <exceptionType> <date>
+//   queued <device> <file>
+//   submitted <device> <file>
+//   failed <device> <file>
+//   summary <submitted> <failed>
+//
+// The exit status is 0 on success, 1 if any crash log failed to submit
+// (or the submit was cancelled), 2 if the submit could not be started and
+// 3 if none of the crash log directories exist, so there is nothing to
+// list or submit. An empty crash log directory is not an error.
+class CommandLineSubmitter : public QObject {
+    Q_OBJECT
+
+public:
+    enum Mode { None, List, DryRun, SubmitAll, Usage };
+    CommandLineSubmitter(Mode mode, QObject *parent = 0);
+    ~CommandLineSubmitter();
+    int run();
+    static Mode modeForArguments(int argc, char *argv[]);
+
+protected:
+    Mode mMode;
+    LogHandler *lhLogHandler;
+    QNetworkAccessManager *qnamAccessor;
+    QTextStream qtsOut;
+    int iExitCode;
+    void list();
+    void printLine(const QStringList &fields);
+
+protected slots:
+    void crashLogQueued(const QString &deviceName, const QString &fileName);
+    void crashLogSubmitted(const QString &deviceName, const QString &fileName, bool success);
+    void submitFinished(int submittedLogs, int failedLogs, bool cancelled);
+};
+
+#endif
@@ -0,0 +1,113 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CompressionHelper.h"
+
+#include <string.h>
+#include <zlib.h>
+
+// Load the preset dictionary from our resources. Returns an
+// empty QByteArray if the dictionary is unavailable.
+QByteArray CompressionHelper::loadPresetDictionary() {
+    QFile f(QLatin1String(":/crashlog_dictionary.dat"));
+    if (! f.open(QIODevice::ReadOnly)) {
+        qWarning("CompressionHelper: Unable to load preset dictionary.");
+        return QByteArray();
+    }
+    QByteArray dictionary = f.readAll();
+    f.close();
+    return dictionary;
+}
+
+// Returns the ID of a preset dictionary, as a hex string. This is the
+// Adler-32 checksum of the dictionary, which is also what zlib stores
+// in the DICTID field of a stream compressed against it.
+QString CompressionHelper::dictionaryId(const QByteArray &dictionary) {
+    uLong adler = adler32(0L, Z_NULL, 0);
+    adler = adler32(adler, reinterpret_cast<const Bytef *>(dictionary.constData()), dictionary.length());
+    return QString::fromLatin1("%1").arg(static_cast<quint32>(adler), 8, 16, QLatin1Char('0'));
+}
+
+// Size of the output buffer used by DeflateWriter.
+static const int DeflateChunkSize = 64 * 1024;
+
+DeflateWriter::DeflateWriter(QIODevice *output, const QByteArray &dictionary) {
+    qiodOutput = output;
+    zsStream = new z_stream;
+    memset(zsStream, 0, sizeof(z_stream));
+
+    bOk = (deflateInit(zsStream, Z_BEST_COMPRESSION) == Z_OK);
+    if (bOk && ! dictionary.isEmpty())
+        bOk = (deflateSetDictionary(zsStream, reinterpret_cast<const Bytef *>(dictionary.constData()), dictionary.length()) == Z_OK);
+}
+
+DeflateWriter::~DeflateWriter() {
+    deflateEnd(zsStream);
+    delete zsStream;
+}
+
+// Run deflate() over the pending input, writing out the compressed
+// data one chunk at a time.
+bool DeflateWriter::pump(int flush) {
+    char buffer[DeflateChunkSize];
+    int ret;
+    do {
+        zsStream->next_out = reinterpret_cast<Bytef *>(buffer);
+        zsStream->avail_out = DeflateChunkSize;
+        ret = deflate(zsStream, flush);
+        if (ret == Z_STREAM_ERROR)
+            return false;
+        qint64 len = DeflateChunkSize - zsStream->avail_out;
+        if (len > 0 && qiodOutput->write(buffer, len) != len)
+            return false;
+    } while (zsStream->avail_out == 0);
+
+    return (flush != Z_FINISH || ret == Z_STREAM_END);
+}
+
+// Compress 'len' bytes from 'data' into the output device.
+bool DeflateWriter::write(const char *data, qint64 len) {
+    if (! bOk)
+        return false;
+    zsStream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    zsStream->avail_in = static_cast<uInt>(len);
+    bOk = pump(Z_NO_FLUSH);
+    return bOk;
+}
+
+// Flush all remaining compressed data to the output device and
+// terminate the zlib stream.
+bool DeflateWriter::finish() {
+    if (! bOk)
+        return false;
+    zsStream->next_in = NULL;
+    zsStream->avail_in = 0;
+    bOk = pump(Z_FINISH);
+    return bOk;
+}
@@ -0,0 +1,69 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __COMPRESSIONHELPER_H__
+#define __COMPRESSIONHELPER_H__
+
+#include <QtCore/QtCore>
+
+struct z_stream_s;
+
+// Helpers for compressing crash log uploads with zlib.
+//
+// Besides plain deflate, we support deflating against a preset dictionary.
+// The dictionary is built by tools/mkcrashdict from a corpus of sample crash
+// logs, and holds the strings (Binary Images lines, system framework frames,
+// header fields) that nearly every Apple crash log contains. Small logs
+// compress much better with it, since a generic compressor would otherwise
+// have no history to refer back to.
+class CompressionHelper {
+    public:
+        static QByteArray loadPresetDictionary();
+        static QString dictionaryId(const QByteArray &dictionary);
+};
+
+// Incrementally deflates data into a QIODevice, optionally against a
+// preset dictionary. Only a fixed-size output buffer is held in memory,
+// so arbitrarily large inputs can be compressed by feeding them in
+// chunks.
+class DeflateWriter {
+    protected:
+        QIODevice *qiodOutput;
+        z_stream_s *zsStream;
+        bool bOk;
+        bool pump(int flush);
+
+    public:
+        DeflateWriter(QIODevice *output, const QByteArray &dictionary = QByteArray());
+        ~DeflateWriter();
+        bool write(const char *data, qint64 len);
+        bool finish();
+};
+
+#endif
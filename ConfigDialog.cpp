@@ -52,6 +52,7 @@ ConfigDialog::ConfigDialog(QWidget *p) : QDialog(p) {
     qleUsername->setText(s->proxyUsername());
     qlePassword->setText(s->proxyPassword());
     qcbJSErrors->setCheckState(s->verboseJavaScriptErrors() ? Qt::Checked : Qt::Unchecked);
+    qsbUploadLimit->setValue(s->uploadRateLimit());
 }
 
 ConfigDialog::~ConfigDialog() {
@@ -76,6 +77,7 @@ void ConfigDialog::apply() {
     s->setProxyUsername(qleUsername->text());
     s->setProxyPassword(qlePassword->text());
     s->setVerboseJavaScriptErrors(qcbJSErrors->checkState() == Qt::Checked);
+    s->setUploadRateLimit(qsbUploadLimit->value());
     s->apply();
 }
 
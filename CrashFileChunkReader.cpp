@@ -0,0 +1,145 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CrashFileChunkReader.h"
+
+CrashFileChunkReader::CrashFileChunkReader(int budgetKb, int firstHandle) {
+    iNextHandle = qMax(firstHandle, 1);
+    setBudget(budgetKb);
+}
+
+CrashFileChunkReader::~CrashFileChunkReader() {
+    foreach (const OpenFile &of, qhOpen)
+        delete of.file;
+}
+
+// Set the memory budget for decoded chunks, in kilobytes. Chunks are
+// evicted least recently used first when it is exceeded.
+void CrashFileChunkReader::setBudget(int budgetKb) {
+    qcChunks.setMaxCost(qBound(64, budgetKb, 1024 * 1024) * 1024);
+}
+
+// Open the crash log at 'path' for reading. Returns a handle for it, or
+// 0 if it could not be opened. If MaxOpenFiles logs are open already, the
+// least recently used one is closed first.
+int CrashFileChunkReader::open(const QString &path) {
+    while (qhOpen.count() >= MaxOpenFiles && ! qlRecent.isEmpty())
+        close(qlRecent.first());
+
+    QFile *f = new QFile(path);
+    if (! f->open(QIODevice::ReadOnly)) {
+        delete f;
+        return 0;
+    }
+
+    QFileInfo fi(path);
+    OpenFile of;
+    of.file = f;
+    of.size = f->size();
+    of.key = QString::fromLatin1("%1:%2:%3").arg(fi.absoluteFilePath()).arg(of.size).arg(fi.lastModified().toTime_t());
+
+    int handle = iNextHandle++;
+    qhOpen.insert(handle, of);
+    qlRecent.append(handle);
+    return handle;
+}
+
+// Get the size in bytes of the log opened as 'handle', or -1 if it is not
+// open.
+qint64 CrashFileChunkReader::size(int handle) const {
+    QHash<int, OpenFile>::const_iterator it = qhOpen.constFind(handle);
+    if (it == qhOpen.constEnd())
+        return -1;
+    return it->size;
+}
+
+// Get the number of chunks in the log opened as 'handle'.
+int CrashFileChunkReader::chunkCount(int handle) const {
+    qint64 n = size(handle);
+    if (n <= 0)
+        return 0;
+    return static_cast<int>((n + ChunkSize - 1) / ChunkSize);
+}
+
+// Read and decode chunk 'chunk' of 'of', or get it from the cache.
+QString CrashFileChunkReader::readChunk(const OpenFile &of, int chunk) {
+    QString key = of.key + QLatin1Char('#') + QString::number(chunk);
+    QString *cached = qcChunks.object(key);
+    if (cached)
+        return *cached;
+
+    // Read a few bytes on either side of the chunk, so its boundaries can
+    // be moved past any UTF-8 continuation bytes.
+    qint64 start = static_cast<qint64>(chunk) * ChunkSize;
+    if (! of.file->seek(start))
+        return QString();
+    QByteArray qba = of.file->read(ChunkSize + 3);
+
+    int begin = 0;
+    while (begin < 3 && begin < qba.length() && (static_cast<uchar>(qba.at(begin)) & 0xc0) == 0x80)
+        begin++;
+    int end = qMin(qba.length(), ChunkSize);
+    while (end < qba.length() && end < ChunkSize + 3 && (static_cast<uchar>(qba.at(end)) & 0xc0) == 0x80)
+        end++;
+    if (chunk == 0)
+        begin = 0;
+
+    QString *decoded = new QString(QString::fromUtf8(qba.constData() + begin, qMax(end - begin, 0)));
+    QString contents = *decoded;
+    qcChunks.insert(key, decoded, qMax(decoded->length() * static_cast<int>(sizeof(QChar)), 1));
+    return contents;
+}
+
+// Read chunks 'firstChunk' through 'firstChunk + chunkCount - 1' of the log
+// opened as 'handle', as a properly-encoded string.
+QString CrashFileChunkReader::read(int handle, int firstChunk, int chunkCount) {
+    QHash<int, OpenFile>::const_iterator it = qhOpen.constFind(handle);
+    if (it == qhOpen.constEnd() || firstChunk < 0 || chunkCount <= 0)
+        return QString();
+
+    qlRecent.removeOne(handle);
+    qlRecent.append(handle);
+
+    // Clamp in 64 bits, so a large 'chunkCount' from the page can't
+    // overflow past the end.
+    int last = static_cast<int>(qMin(static_cast<qint64>(firstChunk) + chunkCount, static_cast<qint64>(this->chunkCount(handle))));
+    QString contents;
+    for (int i = firstChunk; i < last; i++)
+        contents += readChunk(it.value(), i);
+    return contents;
+}
+
+// Close the log opened as 'handle'. Its chunks stay in the cache.
+void CrashFileChunkReader::close(int handle) {
+    if (! qhOpen.contains(handle))
+        return;
+    OpenFile of = qhOpen.take(handle);
+    qlRecent.removeOne(handle);
+    delete of.file;
+}
@@ -0,0 +1,74 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __CRASHFILECHUNKREADER_H__
+#define __CRASHFILECHUNKREADER_H__
+
+#include <QtCore/QtCore>
+
+// Reads crash logs a chunk at a time, for previewing large logs without
+// copying and decoding all of them at once.
+//
+// A log is split into chunks of roughly ChunkSize bytes. Chunk boundaries
+// are moved forward past UTF-8 continuation bytes, so every chunk decodes
+// on its own. Decoded chunks are kept in an LRU cache under a memory budget,
+// keyed by the path, size and modification time of the log, so reopening
+// an unchanged log reuses them.
+//
+// At most MaxOpenFiles logs are kept open. Opening another one closes the
+// least recently used, whose handle is then no longer valid. Handles count
+// up from the 'firstHandle' given to the constructor, so they can be kept
+// apart from other handles handed to the same caller.
+class CrashFileChunkReader {
+    protected:
+        struct OpenFile {
+            QFile *file;
+            QString key;
+            qint64 size;
+        };
+        QHash<int, OpenFile> qhOpen;
+        QList<int> qlRecent;
+        int iNextHandle;
+        QCache<QString, QString> qcChunks;
+        QString readChunk(const OpenFile &of, int chunk);
+
+    public:
+        static const int ChunkSize = 64 * 1024;
+        static const int MaxOpenFiles = 16;
+        CrashFileChunkReader(int budgetKb = 8192, int firstHandle = 1);
+        ~CrashFileChunkReader();
+        void setBudget(int budgetKb);
+        int open(const QString &path);
+        qint64 size(int handle) const;
+        int chunkCount(int handle) const;
+        QString read(int handle, int firstChunk, int chunkCount);
+        void close(int handle);
+};
+
+#endif
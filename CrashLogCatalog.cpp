@@ -0,0 +1,388 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CrashLogCatalog.h"
+#include "CrashLogParser.h"
+
+#include <QtGui/QtGui>
+
+#include <string.h>
+
+static const char CatalogMagic[4] = { 'M', 'C', 'L', 'C' };
+static const quint32 CatalogVersion = 2;
+
+QDataStream &operator<<(QDataStream &out, const CatalogEntry &entry) {
+    return out << entry.path << entry.device << entry.file << entry.size << entry.mtime << entry.version << entry.osVersion << entry.exceptionType << entry.date;
+}
+
+QDataStream &operator>>(QDataStream &in, CatalogEntry &entry) {
+    return in >> entry.path >> entry.device >> entry.file >> entry.size >> entry.mtime >> entry.version >> entry.osVersion >> entry.exceptionType >> entry.date;
+}
+
+CatalogQuery::CatalogQuery() {
+    since = 0;
+    until = 0;
+    newestFirst = true;
+    offset = 0;
+    limit = 50;
+}
+
+CrashLogCatalog::CrashLogCatalog(const QString &path) {
+    qsPath = path;
+    bDirty = false;
+    iNextId = 0;
+    load();
+}
+
+CrashLogCatalog::~CrashLogCatalog() {
+    save();
+}
+
+// Get the path of the on-disk catalog.
+QString CrashLogCatalog::defaultCatalogPath() {
+    QString path = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+    QDir d;
+    d.mkpath(path);
+    return QDir(path).absoluteFilePath(QLatin1String("CrashLogCatalog.dat"));
+}
+
+void CrashLogCatalog::load() {
+    QFile f(qsPath);
+    if (! f.exists())
+        return;
+
+    if (! f.open(QIODevice::ReadOnly)) {
+        qWarning("CrashLogCatalog: Unable to open catalog for reading.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[4];
+    quint32 version = 0;
+    if (qds.readRawData(magic, 4) != 4 || memcmp(magic, CatalogMagic, 4) != 0) {
+        qWarning("CrashLogCatalog: Catalog has bad magic. Ignoring.");
+        return;
+    }
+    qds >> version;
+    if (version != CatalogVersion) {
+        qWarning("CrashLogCatalog: Unknown catalog version %u. Ignoring.", version);
+        return;
+    }
+
+    QHash<QString, CatalogEntry> entries;
+    qds >> entries;
+    if (qds.status() != QDataStream::Ok) {
+        qWarning("CrashLogCatalog: Catalog is corrupt. Ignoring.");
+        return;
+    }
+
+    QHash<QString, CatalogEntry>::const_iterator it;
+    for (it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        quint32 id = iNextId++;
+        qhIds.insert(it.key(), id);
+        addEntry(id, it.value());
+    }
+
+    f.close();
+}
+
+// Write the catalog to disk, if it has changed since it was loaded. Only
+// the entries are stored; the indexes are rebuilt when it is loaded.
+void CrashLogCatalog::save() {
+    QMutexLocker lock(&qmLock);
+    if (! bDirty)
+        return;
+
+    QHash<QString, CatalogEntry> entries;
+    QHash<QString, quint32>::const_iterator it;
+    for (it = qhIds.constBegin(); it != qhIds.constEnd(); ++it)
+        entries.insert(it.key(), qhEntries.value(it.value()));
+
+    QFile f(qsPath);
+    if (! f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("CrashLogCatalog: Unable to open catalog for writing.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+    qds.writeRawData(CatalogMagic, 4);
+    qds << CatalogVersion;
+    qds << entries;
+
+    f.close();
+    bDirty = false;
+}
+
+// Add 'entry' to the entry table and the indexes. The caller must hold
+// qmLock, and take care of qhIds.
+void CrashLogCatalog::addEntry(quint32 id, const CatalogEntry &entry) {
+    qhEntries.insert(id, entry);
+    qmmByDate.insert(entry.date, id);
+    qmByDevice[entry.device].insert(id);
+    qmByVersion[entry.version].insert(id);
+    qmByOsVersion[entry.osVersion].insert(id);
+    qmByExceptionType[entry.exceptionType].insert(id);
+}
+
+static void removeFromIndex(QMap<QString, QSet<quint32> > &index, const QString &value, quint32 id) {
+    QMap<QString, QSet<quint32> >::iterator it = index.find(value);
+    if (it == index.end())
+        return;
+    it->remove(id);
+    if (it->isEmpty())
+        index.erase(it);
+}
+
+// Remove the entry with ID 'id' from the entry table and the indexes. The
+// caller must hold qmLock, and take care of qhIds.
+void CrashLogCatalog::removeEntry(quint32 id) {
+    CatalogEntry entry = qhEntries.take(id);
+    qmmByDate.remove(entry.date, id);
+    removeFromIndex(qmByDevice, entry.device, id);
+    removeFromIndex(qmByVersion, entry.version, id);
+    removeFromIndex(qmByOsVersion, entry.osVersion, id);
+    removeFromIndex(qmByExceptionType, entry.exceptionType, id);
+}
+
+// Parse a crash date, such as '2011-02-03 12:34:56.789 +0100', into seconds
+// since the epoch (UTC). Returns 0 if the date could not be parsed.
+uint CrashLogCatalog::parseDate(const QByteArray &dateTime) {
+    QDateTime dt = QDateTime::fromString(QString::fromLatin1(dateTime.left(19)), QLatin1String("yyyy-MM-dd HH:mm:ss"));
+    if (! dt.isValid())
+        return 0;
+    dt.setTimeSpec(Qt::UTC);
+
+    // Apply the UTC offset, if there is one.
+    int offset = 0;
+    int sign = dateTime.lastIndexOf(' ');
+    if (sign > 0 && dateTime.length() - sign == 6 && (dateTime.at(sign + 1) == '+' || dateTime.at(sign + 1) == '-')) {
+        int hours = dateTime.mid(sign + 2, 2).toInt();
+        int minutes = dateTime.mid(sign + 4, 2).toInt();
+        offset = hours * 3600 + minutes * 60;
+        if (dateTime.at(sign + 1) == '-')
+            offset = -offset;
+    }
+    return dt.toTime_t() - offset;
+}
+
+// Strip the parenthesized part off a header value, as in '1.2.1 (1.2.1)'
+// or 'iPhone OS 4.2.1 (8C148)'.
+static QString headerValue(const QByteArray &value) {
+    int paren = value.indexOf(" (");
+    return QString::fromUtf8(paren >= 0 ? value.left(paren) : value).trimmed();
+}
+
+// Parse the metadata of the crash log at 'path' into 'entry'. Logs without
+// a date are dated by their modification time.
+bool CrashLogCatalog::parseEntry(const QString &path, CatalogEntry &entry) {
+    CrashLogSummary summary;
+    if (! CrashLogParser::parseFile(path, summary))
+        return false;
+
+    QFileInfo fi(path);
+    entry.path = fi.absoluteFilePath();
+    entry.device = fi.dir().dirName();
+    entry.file = fi.fileName();
+    entry.size = fi.size();
+    entry.mtime = fi.lastModified().toTime_t();
+    entry.version = headerValue(summary.version);
+    entry.osVersion = headerValue(summary.osVersion);
+    entry.exceptionType = QString::fromUtf8(summary.exceptionType.split(' ').first());
+    entry.date = parseDate(summary.dateTime);
+    if (entry.date == 0)
+        entry.date = entry.mtime;
+    return true;
+}
+
+// Bring the catalog up to date with the crash logs at 'paths'. Logs are
+// expected to live in a directory named after their device. Only logs that
+// are new to the catalog, or have changed since, are parsed.
+void CrashLogCatalog::update(const QStringList &paths) {
+    QSet<QString> current = QSet<QString>::fromList(paths);
+    {
+        QMutexLocker lock(&qmLock);
+        QHash<QString, quint32>::iterator it = qhIds.begin();
+        while (it != qhIds.end()) {
+            if (current.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            removeEntry(it.value());
+            it = qhIds.erase(it);
+            bDirty = true;
+        }
+    }
+
+    CatalogEntry entry;
+    foreach (QString path, paths)
+        entryForFile(path, entry);
+}
+
+// Get the catalog entry of the crash log at 'path'. Logs that are not in
+// the catalog yet, or whose size or modification time no longer match
+// their entry, are parsed and (re-)added to it. Returns false if the log
+// could not be parsed.
+bool CrashLogCatalog::entryForFile(const QString &path, CatalogEntry &entry) {
+    QFileInfo fi(path);
+    qint64 size = fi.size();
+    uint mtime = fi.lastModified().toTime_t();
+    {
+        QMutexLocker lock(&qmLock);
+        QHash<QString, quint32>::const_iterator it = qhIds.constFind(path);
+        if (it != qhIds.constEnd()) {
+            const CatalogEntry &cached = qhEntries[it.value()];
+            if (cached.size == size && cached.mtime == mtime) {
+                entry = cached;
+                return true;
+            }
+        }
+    }
+
+    // Parse without holding the lock, so queries can go on.
+    if (! parseEntry(path, entry))
+        return false;
+
+    QMutexLocker lock(&qmLock);
+    QHash<QString, quint32>::iterator it = qhIds.find(path);
+    if (it != qhIds.end()) {
+        removeEntry(it.value());
+        addEntry(it.value(), entry);
+    } else {
+        quint32 id = iNextId++;
+        qhIds.insert(path, id);
+        addEntry(id, entry);
+    }
+    bDirty = true;
+    return true;
+}
+
+// Get the catalog entry of the crash log at 'path', if there is one and
+// it still matches the log's current 'size' and 'mtime'. Unlike
+// entryForFile(), this never parses the log.
+bool CrashLogCatalog::cachedEntryForFile(const QString &path, qint64 size, uint mtime, CatalogEntry &entry) {
+    QMutexLocker lock(&qmLock);
+    QHash<QString, quint32>::const_iterator it = qhIds.constFind(path);
+    if (it == qhIds.constEnd())
+        return false;
+
+    const CatalogEntry &cached = qhEntries[it.value()];
+    if (cached.size != size || cached.mtime != mtime)
+        return false;
+    entry = cached;
+    return true;
+}
+
+static bool entryMatches(const CatalogEntry &entry, const CatalogQuery &query) {
+    if (! query.device.isEmpty() && entry.device != query.device)
+        return false;
+    if (! query.version.isEmpty() && entry.version != query.version)
+        return false;
+    if (! query.osVersion.isEmpty() && entry.osVersion != query.osVersion)
+        return false;
+    if (! query.exceptionType.isEmpty() && entry.exceptionType != query.exceptionType)
+        return false;
+    if (query.since && entry.date < query.since)
+        return false;
+    if (query.until && entry.date > query.until)
+        return false;
+    return true;
+}
+
+// Run 'query' against the catalog, and return the requested page of
+// results.
+//
+// With equality conditions, the smallest matching set from the value
+// indexes is filtered by the remaining conditions, and sorted by date.
+// Otherwise, the date index is walked over the requested range, which
+// is already in order.
+CatalogPage CrashLogCatalog::query(const CatalogQuery &query) {
+    CatalogPage page;
+    page.total = 0;
+
+    // An empty range; walking the date index over it would run past its end.
+    if (query.until && query.since > query.until)
+        return page;
+
+    QMutexLocker lock(&qmLock);
+
+    const QSet<quint32> *candidates = NULL;
+    const QString *values[] = {
+        &query.device,
+        &query.version,
+        &query.osVersion,
+        &query.exceptionType,
+    };
+    const QMap<QString, QSet<quint32> > *indexes[] = {
+        &qmByDevice,
+        &qmByVersion,
+        &qmByOsVersion,
+        &qmByExceptionType,
+    };
+    for (size_t c = 0; c < sizeof(values) / sizeof(values[0]); c++) {
+        const QString &value = *values[c];
+        if (value.isEmpty())
+            continue;
+        QMap<QString, QSet<quint32> >::const_iterator it = indexes[c]->constFind(value);
+        if (it == indexes[c]->constEnd())
+            return page;
+        if (! candidates || it->count() < candidates->count())
+            candidates = &it.value();
+    }
+
+    QList<quint32> matches;
+    if (candidates) {
+        QList<QPair<uint, quint32> > dated;
+        foreach (quint32 id, *candidates) {
+            const CatalogEntry &entry = qhEntries[id];
+            if (entryMatches(entry, query))
+                dated << qMakePair(entry.date, id);
+        }
+        qSort(dated);
+        for (int i = 0; i < dated.count(); i++)
+            matches << dated.at(i).second;
+    } else {
+        QMultiMap<uint, quint32>::const_iterator it = qmmByDate.lowerBound(query.since);
+        QMultiMap<uint, quint32>::const_iterator end = query.until ? qmmByDate.upperBound(query.until) : qmmByDate.constEnd();
+        for (; it != end; ++it)
+            matches << it.value();
+    }
+
+    page.total = matches.count();
+    int count = query.limit > 0 ? query.limit : page.total;
+    for (int i = qMax(query.offset, 0); i < page.total && count > 0; i++, count--) {
+        int idx = query.newestFirst ? page.total - 1 - i : i;
+        page.entries << qhEntries.value(matches.at(idx));
+    }
+    return page;
+}
@@ -0,0 +1,116 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __CRASHLOGCATALOG_H__
+#define __CRASHLOGCATALOG_H__
+
+#include <QtCore/QtCore>
+
+// The metadata of a crash log, as kept in the catalog.
+struct CatalogEntry {
+    QString path;
+    QString device;
+    QString file;
+    qint64 size;
+    uint mtime;
+    QString version;
+    QString osVersion;
+    QString exceptionType;
+    uint date;
+};
+
+// A query against the catalog. Empty strings match anything, as do
+// zero 'since' and 'until' times. Results are sorted by crash date.
+struct CatalogQuery {
+    QString device;
+    QString version;
+    QString osVersion;
+    QString exceptionType;
+    uint since;
+    uint until;
+    bool newestFirst;
+    int offset;
+    int limit;
+
+    CatalogQuery();
+};
+
+// A page of query results, along with the total number of matches.
+struct CatalogPage {
+    int total;
+    QList<CatalogEntry> entries;
+};
+
+// A persistent catalog of the metadata of the crash logs in the crash log
+// directory: the device they came from, the app and OS versions, the type
+// of exception and the date of the crash.
+//
+// Besides the entries themselves, the catalog keeps secondary indexes: a
+// map from crash date to entries, for range queries and sorting, and a map
+// from each distinct value of the other fields to the entries that have
+// it, for equality queries. Entries are tied to the size and modification
+// time of their log, so only logs that are new to the catalog, or that have
+// changed since they were parsed, are parsed when it is updated.
+//
+// update() and query() may be called from worker threads. Only one
+// update() may run at a time; queries can run alongside it.
+class CrashLogCatalog {
+    protected:
+        QMutex qmLock;
+        QString qsPath;
+        bool bDirty;
+        quint32 iNextId;
+        QHash<quint32, CatalogEntry> qhEntries;
+        QHash<QString, quint32> qhIds;
+        QMultiMap<uint, quint32> qmmByDate;
+        QMap<QString, QSet<quint32> > qmByDevice;
+        QMap<QString, QSet<quint32> > qmByVersion;
+        QMap<QString, QSet<quint32> > qmByOsVersion;
+        QMap<QString, QSet<quint32> > qmByExceptionType;
+        void load();
+        void addEntry(quint32 id, const CatalogEntry &entry);
+        void removeEntry(quint32 id);
+        static bool parseEntry(const QString &path, CatalogEntry &entry);
+        static uint parseDate(const QByteArray &dateTime);
+
+    public:
+        CrashLogCatalog(const QString &path = CrashLogCatalog::defaultCatalogPath());
+        ~CrashLogCatalog();
+        void update(const QStringList &paths);
+        CatalogPage query(const CatalogQuery &query);
+        bool entryForFile(const QString &path, CatalogEntry &entry);
+        bool cachedEntryForFile(const QString &path, qint64 size, uint mtime, CatalogEntry &entry);
+        void save();
+        static QString defaultCatalogPath();
+};
+
+QDataStream &operator<<(QDataStream &out, const CatalogEntry &entry);
+QDataStream &operator>>(QDataStream &in, CatalogEntry &entry);
+
+#endif
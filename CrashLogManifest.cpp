@@ -0,0 +1,210 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CrashLogManifest.h"
+#include "SubmittedLogIndex.h"
+
+#include <QtGui/QtGui>
+
+#include <string.h>
+
+static const char ManifestMagic[4] = { 'M', 'C', 'L', 'M' };
+static const quint32 ManifestVersion = 1;
+
+QDataStream &operator<<(QDataStream &out, const ManifestDirectory &dir) {
+    return out << dir.mtime << dir.scanned << dir.subdirectories << dir.files;
+}
+
+QDataStream &operator>>(QDataStream &in, ManifestDirectory &dir) {
+    return in >> dir.mtime >> dir.scanned >> dir.subdirectories >> dir.files;
+}
+
+QDataStream &operator<<(QDataStream &out, const ManifestFile &file) {
+    return out << file.size << file.mtime << file.hash;
+}
+
+QDataStream &operator>>(QDataStream &in, ManifestFile &file) {
+    return in >> file.size >> file.mtime >> file.hash;
+}
+
+CrashLogManifest::CrashLogManifest(const QString &path) {
+    qsPath = path;
+    bDirty = false;
+    load();
+}
+
+CrashLogManifest::~CrashLogManifest() {
+    save();
+}
+
+// Get the path of the on-disk manifest.
+QString CrashLogManifest::defaultManifestPath() {
+    QString path = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+    QDir d;
+    d.mkpath(path);
+    return QDir(path).absoluteFilePath(QLatin1String("CrashLogManifest.dat"));
+}
+
+void CrashLogManifest::load() {
+    QFile f(qsPath);
+    if (! f.exists())
+        return;
+
+    if (! f.open(QIODevice::ReadOnly)) {
+        qWarning("CrashLogManifest: Unable to open manifest for reading.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[4];
+    quint32 version = 0;
+    if (qds.readRawData(magic, 4) != 4 || memcmp(magic, ManifestMagic, 4) != 0) {
+        qWarning("CrashLogManifest: Manifest has bad magic. Ignoring.");
+        return;
+    }
+    qds >> version;
+    if (version != ManifestVersion) {
+        qWarning("CrashLogManifest: Unknown manifest version %u. Ignoring.", version);
+        return;
+    }
+
+    qds >> qhDirectories >> qhFiles;
+    if (qds.status() != QDataStream::Ok) {
+        qWarning("CrashLogManifest: Manifest is corrupt. Ignoring.");
+        qhDirectories.clear();
+        qhFiles.clear();
+    }
+
+    f.close();
+}
+
+// Write the manifest to disk, if it has changed since it was loaded.
+void CrashLogManifest::save() {
+    QMutexLocker lock(&qmLock);
+    if (! bDirty)
+        return;
+
+    QFile f(qsPath);
+    if (! f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("CrashLogManifest: Unable to open manifest for writing.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+    qds.writeRawData(ManifestMagic, 4);
+    qds << ManifestVersion;
+    qds << qhDirectories << qhFiles;
+
+    f.close();
+    bDirty = false;
+}
+
+// Returns the (possibly cached) listing of the directory at 'path'. The
+// lock is not held while the directory is being listed, so directories
+// can be listed on several threads at once.
+ManifestDirectory CrashLogManifest::directory(const QString &path) {
+    QFileInfo fi(path);
+    uint mtime = fi.lastModified().toTime_t();
+
+    QMutexLocker lock(&qmLock);
+    QHash<QString, ManifestDirectory>::const_iterator it = qhDirectories.constFind(path);
+    if (it != qhDirectories.constEnd() && it->mtime == mtime && mtime + 1 < it->scanned)
+        return *it;
+    lock.unlock();
+
+    ManifestDirectory dir;
+    dir.mtime = mtime;
+    dir.scanned = QDateTime::currentDateTime().toTime_t();
+
+    QDir d(path);
+    foreach (QFileInfo entry, d.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot, QDir::Name)) {
+        if (entry.isDir())
+            dir.subdirectories << entry.fileName();
+        else
+            dir.files << entry.fileName();
+    }
+
+    lock.relock();
+
+    // Forget the hashes of files that have disappeared.
+    it = qhDirectories.constFind(path);
+    if (it != qhDirectories.constEnd()) {
+        QSet<QString> current = QSet<QString>::fromList(dir.files);
+        foreach (QString file, it->files) {
+            if (! current.contains(file))
+                qhFiles.remove(d.filePath(file));
+        }
+    }
+
+    bDirty = true;
+    qhDirectories.insert(path, dir);
+    return dir;
+}
+
+// Returns the names of the subdirectories of the directory at 'path'.
+QStringList CrashLogManifest::subdirectories(const QString &path) {
+    return directory(path).subdirectories;
+}
+
+// Returns the names of the files in the directory at 'path'.
+QStringList CrashLogManifest::files(const QString &path) {
+    return directory(path).files;
+}
+
+// Returns the content hash of the file at 'path'. The file is only
+// read if it has changed since it was last hashed. The lock is not held
+// while the file is being read.
+QByteArray CrashLogManifest::hashForFile(const QString &path) {
+    QFileInfo fi(path);
+    qint64 size = fi.size();
+    uint mtime = fi.lastModified().toTime_t();
+
+    QMutexLocker lock(&qmLock);
+    QHash<QString, ManifestFile>::const_iterator it = qhFiles.constFind(path);
+    if (it != qhFiles.constEnd() && it->size == size && it->mtime == mtime)
+        return it->hash;
+    lock.unlock();
+
+    ManifestFile file;
+    file.size = size;
+    file.mtime = mtime;
+    file.hash = SubmittedLogIndex::hashForFile(path);
+
+    lock.relock();
+    if (! file.hash.isEmpty()) {
+        qhFiles.insert(path, file);
+        bDirty = true;
+    }
+    return file.hash;
+}
@@ -0,0 +1,92 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __CRASHLOGMANIFEST_H__
+#define __CRASHLOGMANIFEST_H__
+
+#include <QtCore/QtCore>
+
+// The cached listing of a directory, valid for as long as the
+// directory's modification time stays the same.
+struct ManifestDirectory {
+    uint mtime;
+    uint scanned;
+    QStringList subdirectories;
+    QStringList files;
+};
+
+// The cached content hash of a file, valid for as long as the
+// file's size and modification time stay the same.
+struct ManifestFile {
+    qint64 size;
+    uint mtime;
+    QByteArray hash;
+};
+
+// A persistent manifest of the crash log directories.
+//
+// Listing the MobileDevice tree and hashing every crash log in it gets
+// slow once years of logs from many devices have piled up. The manifest
+// remembers the listing of each directory along with its mtime, and the
+// content hash of each file along with its size and mtime. Later scans
+// only need to stat() each directory; only directories that changed are
+// listed again, and only files that changed are hashed again.
+//
+// Directories modified within a second of being scanned are always
+// rescanned, since a file could have been added within the same second
+// without changing the recorded mtime.
+//
+// The manifest is shared between the GUI thread and the worker threads
+// that scan the crash log directories, so all access goes through a mutex.
+class CrashLogManifest {
+    protected:
+        QMutex qmLock;
+        QString qsPath;
+        QHash<QString, ManifestDirectory> qhDirectories;
+        QHash<QString, ManifestFile> qhFiles;
+        bool bDirty;
+        void load();
+        ManifestDirectory directory(const QString &path);
+
+    public:
+        CrashLogManifest(const QString &path = CrashLogManifest::defaultManifestPath());
+        ~CrashLogManifest();
+        QStringList subdirectories(const QString &path);
+        QStringList files(const QString &path);
+        QByteArray hashForFile(const QString &path);
+        void save();
+        static QString defaultManifestPath();
+};
+
+QDataStream &operator<<(QDataStream &out, const ManifestDirectory &dir);
+QDataStream &operator>>(QDataStream &in, ManifestDirectory &dir);
+QDataStream &operator<<(QDataStream &out, const ManifestFile &file);
+QDataStream &operator>>(QDataStream &in, ManifestFile &file);
+
+#endif
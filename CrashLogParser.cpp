@@ -0,0 +1,779 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CrashLogParser.h"
+
+#include <string.h>
+
+CrashLogSummary::CrashLogSummary() {
+    crashedThread = -1;
+}
+
+// Returns a signature for the crash, for telling repeats of the same crash
+// apart from other crashes. This is the SHA-1 of the exception type and the
+// image and symbol of the top 'depth' frames of the crashed thread.
+//
+// Frames that haven't been symbolicated read like '0x1000 + 43981'. Only
+// their offset into the image is used, since the load address may differ
+// from run to run. Returns an empty signature if there is no backtrace.
+QByteArray CrashLogSummary::signature(int depth) const {
+    if (frames.isEmpty())
+        return QByteArray();
+
+    QCryptographicHash qch(QCryptographicHash::Sha1);
+    qch.addData(exceptionType);
+    qch.addData("\n", 1);
+    for (int i = 0; i < frames.count() && i < depth; i++) {
+        const CrashLogFrame &frame = frames.at(i);
+        QByteArray symbol = frame.symbol;
+        if (symbol.startsWith("0x")) {
+            int plus = symbol.indexOf('+');
+            if (plus >= 0)
+                symbol = symbol.mid(plus);
+        }
+        qch.addData(frame.image);
+        qch.addData("\t", 1);
+        qch.addData(symbol);
+        qch.addData("\n", 1);
+    }
+    return qch.result();
+}
+
+// Convert the summary into a compact form for JavaScript. Addresses are
+// passed as hex strings, since they don't fit in a JavaScript number.
+// Frames are lists of [index, image, address, symbol], and images are
+// lists of [base, end, name, arch, uuid, path].
+QVariantMap CrashLogSummary::toVariantMap() const {
+    QVariantMap map;
+    map.insert(QLatin1String("incidentIdentifier"), QString::fromUtf8(incidentIdentifier));
+    map.insert(QLatin1String("hardwareModel"), QString::fromUtf8(hardwareModel));
+    map.insert(QLatin1String("osVersion"), QString::fromUtf8(osVersion));
+    map.insert(QLatin1String("version"), QString::fromUtf8(version));
+    map.insert(QLatin1String("dateTime"), QString::fromUtf8(dateTime));
+    map.insert(QLatin1String("exceptionType"), QString::fromUtf8(exceptionType));
+    map.insert(QLatin1String("exceptionCodes"), QString::fromUtf8(exceptionCodes));
+    map.insert(QLatin1String("crashedThread"), crashedThread);
+    map.insert(QLatin1String("signature"), QString::fromLatin1(signature().toHex()));
+
+    QVariantList frameList;
+    foreach (const CrashLogFrame &frame, frames) {
+        QVariantList entry;
+        entry << frame.index;
+        entry << QString::fromUtf8(frame.image);
+        entry << QString::fromLatin1("0x%1").arg(frame.address, 0, 16);
+        entry << QString::fromUtf8(frame.symbol);
+        frameList << QVariant(entry);
+    }
+    map.insert(QLatin1String("frames"), frameList);
+
+    QVariantList imageList;
+    foreach (const CrashLogImage &image, images) {
+        QVariantList entry;
+        entry << QString::fromLatin1("0x%1").arg(image.base, 0, 16);
+        entry << QString::fromLatin1("0x%1").arg(image.end, 0, 16);
+        entry << QString::fromUtf8(image.name);
+        entry << QString::fromUtf8(image.arch);
+        entry << QString::fromUtf8(image.uuid);
+        entry << QString::fromUtf8(image.path);
+        imageList << QVariant(entry);
+    }
+    map.insert(QLatin1String("images"), imageList);
+
+    return map;
+}
+
+// The header fields we're interested in, and where they go.
+struct HeaderField {
+    const char *key;
+    int len;
+    QByteArray CrashLogSummary::*field;
+};
+
+#define HEADER_FIELD(key, field) { key, sizeof(key) - 1, &CrashLogSummary::field }
+
+static const HeaderField HeaderFields[] = {
+    HEADER_FIELD("Incident Identifier:", incidentIdentifier),
+    HEADER_FIELD("Hardware Model:", hardwareModel),
+    HEADER_FIELD("OS Version:", osVersion),
+    HEADER_FIELD("Version:", version),
+    HEADER_FIELD("Date/Time:", dateTime),
+    HEADER_FIELD("Exception Type:", exceptionType),
+    HEADER_FIELD("Exception Codes:", exceptionCodes),
+};
+
+#undef HEADER_FIELD
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline const char *skipBlanks(const char *p, const char *end) {
+    while (p < end && isBlank(*p))
+        ++p;
+    return p;
+}
+
+static inline const char *trimBlanks(const char *begin, const char *end) {
+    while (end > begin && isBlank(end[-1]))
+        --end;
+    return end;
+}
+
+static inline bool startsWith(const char *p, const char *end, const char *prefix, int len) {
+    return end - p >= len && memcmp(p, prefix, len) == 0;
+}
+
+// Parse the hex digits at 'p' into 'value'. Returns a pointer to the first
+// character that isn't a hex digit.
+static const char *parseHex(const char *p, const char *end, quint64 &value) {
+    value = 0;
+    for (; p < end; ++p) {
+        char c = *p;
+        if (c >= '0' && c <= '9')
+            value = (value << 4) | static_cast<quint64>(c - '0');
+        else if (c >= 'a' && c <= 'f')
+            value = (value << 4) | static_cast<quint64>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')
+            value = (value << 4) | static_cast<quint64>(c - 'A' + 10);
+        else
+            break;
+    }
+    return p;
+}
+
+// Parse a line from the header of the log, such as
+//
+//   Hardware Model:      iPhone3,1
+void CrashLogParser::parseHeaderLine(const char *line, const char *end, CrashLogSummary &summary) {
+    static const char CrashedThreadKey[] = "Crashed Thread:";
+    if (startsWith(line, end, CrashedThreadKey, sizeof(CrashedThreadKey) - 1)) {
+        const char *p = skipBlanks(line + sizeof(CrashedThreadKey) - 1, end);
+        int thread = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p)
+            thread = thread * 10 + (*p - '0');
+        summary.crashedThread = thread;
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(HeaderFields) / sizeof(HeaderFields[0]); i++) {
+        const HeaderField &hf = HeaderFields[i];
+        if (! startsWith(line, end, hf.key, hf.len))
+            continue;
+        const char *value = skipBlanks(line + hf.len, end);
+        summary.*hf.field = QByteArray(value, trimBlanks(value, end) - value);
+        return;
+    }
+}
+
+// Parse a line of a thread's backtrace, such as
+//
+//   0   libobjc.A.dylib               	0x33479464 objc_msgSend + 16
+//
+// The image name may contain spaces, so it runs up to the first '0x'
+// that follows a blank.
+bool CrashLogParser::parseFrameLine(const char *line, const char *end, CrashLogFrame &frame) {
+    const char *p = line;
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+
+    frame.index = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        frame.index = frame.index * 10 + (*p - '0');
+
+    const char *image = skipBlanks(p, end);
+    const char *addr = NULL;
+    for (const char *q = image + 1; q + 1 < end; ++q) {
+        if (q[0] == '0' && q[1] == 'x' && isBlank(q[-1])) {
+            addr = q;
+            break;
+        }
+    }
+    if (! addr)
+        return false;
+
+    frame.image = QByteArray(image, trimBlanks(image, addr) - image);
+    p = skipBlanks(parseHex(addr + 2, end, frame.address), end);
+    frame.symbol = QByteArray(p, trimBlanks(p, end) - p);
+    return true;
+}
+
+// Parse a line of the Binary Images table, such as
+//
+//   0x1000 -    0x8ffff +Mumble armv7  <1a2b3c...> /var/mobile/Applications/.../Mumble
+//
+// The image name may contain spaces, so the architecture is taken to be
+// the last word before the UUID.
+bool CrashLogParser::parseImageLine(const char *line, const char *end, CrashLogImage &image) {
+    const char *p = skipBlanks(line, end);
+    if (! startsWith(p, end, "0x", 2))
+        return false;
+    p = skipBlanks(parseHex(p + 2, end, image.base), end);
+    if (p == end || *p != '-')
+        return false;
+    p = skipBlanks(p + 1, end);
+    if (! startsWith(p, end, "0x", 2))
+        return false;
+    p = skipBlanks(parseHex(p + 2, end, image.end), end);
+    if (p < end && *p == '+')
+        ++p;
+
+    const char *lt = static_cast<const char *>(memchr(p, '<', end - p));
+    if (! lt)
+        return false;
+    const char *gt = static_cast<const char *>(memchr(lt, '>', end - lt));
+    if (! gt)
+        return false;
+
+    const char *archEnd = trimBlanks(p, lt);
+    const char *arch = archEnd;
+    while (arch > p && ! isBlank(arch[-1]))
+        --arch;
+    image.arch = QByteArray(arch, archEnd - arch);
+    image.name = QByteArray(p, trimBlanks(p, arch) - p);
+    image.uuid = QByteArray(lt + 1, gt - lt - 1);
+
+    const char *path = skipBlanks(gt + 1, end);
+    image.path = QByteArray(path, trimBlanks(path, end) - path);
+    return true;
+}
+
+// A cursor over JSON text, for pulling out the few fields of an .ips
+// report we're after. Malformed input moves the cursor to the end, which
+// ends all loops over objects and arrays.
+struct JsonCursor {
+    const char *p;
+    const char *end;
+};
+
+static inline void jsonFail(JsonCursor &c) {
+    c.p = c.end;
+}
+
+static inline void jsonSkipSpace(JsonCursor &c) {
+    while (c.p < c.end && (*c.p == ' ' || *c.p == '\t' || *c.p == '\n' || *c.p == '\r'))
+        ++c.p;
+}
+
+static inline bool jsonConsume(JsonCursor &c, char ch) {
+    jsonSkipSpace(c);
+    if (c.p < c.end && *c.p == ch) {
+        ++c.p;
+        return true;
+    }
+    return false;
+}
+
+template <int N>
+static inline bool keyIs(const char *key, int len, const char (&name)[N]) {
+    return len == N - 1 && memcmp(key, name, N - 1) == 0;
+}
+
+// Find the string at the cursor, and set 'begin' and 'stop' to its (still
+// escaped) contents. Closing quotes are found with memchr(); a quote is
+// escaped if an odd number of backslashes comes right before it.
+static bool jsonRawString(JsonCursor &c, const char *&begin, const char *&stop) {
+    jsonSkipSpace(c);
+    if (c.p >= c.end || *c.p != '"') {
+        jsonFail(c);
+        return false;
+    }
+    begin = ++c.p;
+    while (c.p < c.end) {
+        const char *quote = static_cast<const char *>(memchr(c.p, '"', c.end - c.p));
+        if (! quote)
+            break;
+        const char *q = quote;
+        while (q > begin && q[-1] == '\\')
+            --q;
+        c.p = quote + 1;
+        if (((quote - q) & 1) == 0) {
+            stop = quote;
+            return true;
+        }
+    }
+    jsonFail(c);
+    return false;
+}
+
+static inline int hexDigit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Decode the escaped JSON string contents between 'begin' and 'end' into
+// UTF-8. Strings without escapes, which is nearly all of them, are copied
+// as they are.
+static QByteArray jsonDecode(const char *begin, const char *end) {
+    if (! memchr(begin, '\\', end - begin))
+        return QByteArray(begin, end - begin);
+
+    QByteArray out;
+    out.reserve(end - begin);
+    QString pending;
+    for (const char *p = begin; p < end; ++p) {
+        if (*p != '\\' || p + 1 >= end) {
+            if (! pending.isEmpty()) {
+                out += pending.toUtf8();
+                pending.clear();
+            }
+            out += *p;
+            continue;
+        }
+
+        char e = *++p;
+        if (e == 'u' && p + 4 < end) {
+            int code = 0;
+            for (int i = 1; i <= 4; i++)
+                code = (code << 4) | qMax(hexDigit(p[i]), 0);
+            p += 4;
+            // Collected, so surrogate pairs come out right.
+            pending += QChar(static_cast<ushort>(code));
+            continue;
+        }
+
+        if (! pending.isEmpty()) {
+            out += pending.toUtf8();
+            pending.clear();
+        }
+        switch (e) {
+            case 'n':
+                out += '\n';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            default:
+                out += e;
+        }
+    }
+    if (! pending.isEmpty())
+        out += pending.toUtf8();
+    return out;
+}
+
+// Skip the value at the cursor, whatever it is.
+static void jsonSkipValue(JsonCursor &c) {
+    jsonSkipSpace(c);
+    int depth = 0;
+    while (c.p < c.end) {
+        char ch = *c.p;
+        if (ch == '"') {
+            const char *begin, *stop;
+            if (! jsonRawString(c, begin, stop) || depth == 0)
+                return;
+            continue;
+        }
+        if (ch == '{' || ch == '[') {
+            depth++;
+        } else if (ch == '}' || ch == ']') {
+            if (depth == 0)
+                return;
+            if (--depth == 0) {
+                ++c.p;
+                return;
+            }
+        } else if (ch == ',' && depth == 0) {
+            return;
+        }
+        ++c.p;
+    }
+}
+
+// Step to the next member of the object at the cursor. Start with 'first'
+// set, and the cursor on the opening brace. Returns false once the object
+// has ended; otherwise, 'key' holds the member's name, and the cursor is on
+// its value, which must be consumed before the next call.
+static bool jsonNextMember(JsonCursor &c, bool &first, const char *&key, int &keyLen) {
+    if (first) {
+        first = false;
+        if (! jsonConsume(c, '{')) {
+            jsonSkipValue(c);
+            return false;
+        }
+        if (jsonConsume(c, '}'))
+            return false;
+    } else if (! jsonConsume(c, ',')) {
+        if (! jsonConsume(c, '}'))
+            jsonFail(c);
+        return false;
+    }
+
+    const char *stop;
+    if (! jsonRawString(c, key, stop) || ! jsonConsume(c, ':')) {
+        jsonFail(c);
+        return false;
+    }
+    keyLen = static_cast<int>(stop - key);
+    return true;
+}
+
+// Step to the next element of the array at the cursor, like jsonNextMember().
+static bool jsonNextElement(JsonCursor &c, bool &first) {
+    if (first) {
+        first = false;
+        if (! jsonConsume(c, '[')) {
+            jsonSkipValue(c);
+            return false;
+        }
+        return ! jsonConsume(c, ']');
+    }
+    if (jsonConsume(c, ','))
+        return true;
+    if (! jsonConsume(c, ']'))
+        jsonFail(c);
+    return false;
+}
+
+// Read the string at the cursor. Values of other types are skipped, and
+// read as empty.
+static QByteArray jsonString(JsonCursor &c) {
+    jsonSkipSpace(c);
+    if (c.p >= c.end || *c.p != '"') {
+        jsonSkipValue(c);
+        return QByteArray();
+    }
+    const char *begin, *stop;
+    if (! jsonRawString(c, begin, stop))
+        return QByteArray();
+    return jsonDecode(begin, stop);
+}
+
+// Read the non-negative integer at the cursor. Fractions are dropped, and
+// values of other types are skipped and read as 'fallback'.
+static quint64 jsonInteger(JsonCursor &c, quint64 fallback = 0) {
+    jsonSkipSpace(c);
+    if (c.p >= c.end || *c.p < '0' || *c.p > '9') {
+        jsonSkipValue(c);
+        return fallback;
+    }
+    quint64 value = 0;
+    for (; c.p < c.end && *c.p >= '0' && *c.p <= '9'; ++c.p)
+        value = value * 10 + static_cast<quint64>(*c.p - '0');
+    jsonSkipValue(c);
+    return value;
+}
+
+// Read the boolean at the cursor.
+static bool jsonBool(JsonCursor &c) {
+    jsonSkipSpace(c);
+    bool value = c.end - c.p >= 4 && memcmp(c.p, "true", 4) == 0;
+    jsonSkipValue(c);
+    return value;
+}
+
+// Parse the frames of a thread of an .ips report into 'frames', along with
+// the index of each frame's image in 'imageIndexes'. Frames hold offsets
+// into their image; they are made absolute once the images are known.
+static void parseIpsFrames(JsonCursor &c, QVector<CrashLogFrame> &frames, QVector<int> &imageIndexes) {
+    bool firstFrame = true;
+    while (jsonNextElement(c, firstFrame)) {
+        CrashLogFrame frame;
+        frame.index = frames.count();
+        frame.address = 0;
+        quint64 symbolLocation = 0;
+        int imageIndex = -1;
+
+        bool first = true;
+        const char *key;
+        int keyLen;
+        while (jsonNextMember(c, first, key, keyLen)) {
+            if (keyIs(key, keyLen, "imageOffset"))
+                frame.address = jsonInteger(c);
+            else if (keyIs(key, keyLen, "imageIndex"))
+                imageIndex = static_cast<int>(jsonInteger(c, static_cast<quint64>(-1)));
+            else if (keyIs(key, keyLen, "symbol"))
+                frame.symbol = jsonString(c);
+            else if (keyIs(key, keyLen, "symbolLocation"))
+                symbolLocation = jsonInteger(c);
+            else
+                jsonSkipValue(c);
+        }
+
+        if (! frame.symbol.isEmpty())
+            frame.symbol += " + " + QByteArray::number(symbolLocation);
+        frames.append(frame);
+        imageIndexes.append(imageIndex);
+    }
+}
+
+// Parse the usedImages table of an .ips report into 'images'.
+static void parseIpsImages(JsonCursor &c, QVector<CrashLogImage> &images) {
+    bool firstImage = true;
+    while (jsonNextElement(c, firstImage)) {
+        CrashLogImage image;
+        image.base = 0;
+        quint64 size = 0;
+
+        bool first = true;
+        const char *key;
+        int keyLen;
+        while (jsonNextMember(c, first, key, keyLen)) {
+            if (keyIs(key, keyLen, "base"))
+                image.base = jsonInteger(c);
+            else if (keyIs(key, keyLen, "size"))
+                size = jsonInteger(c);
+            else if (keyIs(key, keyLen, "name"))
+                image.name = jsonString(c);
+            else if (keyIs(key, keyLen, "arch"))
+                image.arch = jsonString(c);
+            else if (keyIs(key, keyLen, "uuid"))
+                image.uuid = jsonString(c);
+            else if (keyIs(key, keyLen, "path"))
+                image.path = jsonString(c);
+            else
+                jsonSkipValue(c);
+        }
+
+        image.end = size ? image.base + size - 1 : image.base;
+        images.append(image);
+    }
+}
+
+// Parse an .ips report: a line of JSON header, followed by a JSON body. The
+// fields are turned into the form they take in a .crash log, so the rest of
+// the crash reporter needn't care which kind of log it is looking at.
+void CrashLogParser::parseIps(const char *data, qint64 len, CrashLogSummary &summary) {
+    const char *end = data + len;
+    const char *eol = static_cast<const char *>(memchr(data, '\n', len));
+    if (! eol)
+        eol = end;
+
+    QByteArray appVersion, buildVersion;
+    bool first = true;
+    const char *key;
+    int keyLen;
+    JsonCursor header = { data, eol };
+    while (jsonNextMember(header, first, key, keyLen)) {
+        if (keyIs(key, keyLen, "app_version"))
+            appVersion = jsonString(header);
+        else if (keyIs(key, keyLen, "build_version"))
+            buildVersion = jsonString(header);
+        else if (keyIs(key, keyLen, "os_version"))
+            summary.osVersion = jsonString(header);
+        else if (keyIs(key, keyLen, "incident_id"))
+            summary.incidentIdentifier = jsonString(header);
+        else if (keyIs(key, keyLen, "timestamp"))
+            summary.dateTime = jsonString(header);
+        else
+            jsonSkipValue(header);
+    }
+
+    QByteArray exceptionType, exceptionSignal;
+    QVector<int> imageIndexes;
+    int faultingThread = -1;
+    JsonCursor body = { eol, end };
+    first = true;
+    while (jsonNextMember(body, first, key, keyLen)) {
+        if (keyIs(key, keyLen, "incident")) {
+            summary.incidentIdentifier = jsonString(body);
+        } else if (keyIs(key, keyLen, "modelCode")) {
+            summary.hardwareModel = jsonString(body);
+        } else if (keyIs(key, keyLen, "captureTime")) {
+            summary.dateTime = jsonString(body);
+        } else if (keyIs(key, keyLen, "faultingThread")) {
+            faultingThread = static_cast<int>(jsonInteger(body, static_cast<quint64>(-1)));
+        } else if (keyIs(key, keyLen, "bundleInfo")) {
+            bool firstMember = true;
+            while (jsonNextMember(body, firstMember, key, keyLen)) {
+                if (keyIs(key, keyLen, "CFBundleShortVersionString"))
+                    appVersion = jsonString(body);
+                else if (keyIs(key, keyLen, "CFBundleVersion"))
+                    buildVersion = jsonString(body);
+                else
+                    jsonSkipValue(body);
+            }
+        } else if (keyIs(key, keyLen, "osVersion")) {
+            // Only needed if the header didn't have it.
+            QByteArray train, build;
+            bool firstMember = true;
+            while (jsonNextMember(body, firstMember, key, keyLen)) {
+                if (keyIs(key, keyLen, "train"))
+                    train = jsonString(body);
+                else if (keyIs(key, keyLen, "build"))
+                    build = jsonString(body);
+                else
+                    jsonSkipValue(body);
+            }
+            if (summary.osVersion.isEmpty() && ! train.isEmpty())
+                summary.osVersion = build.isEmpty() ? train : train + " (" + build + ")";
+        } else if (keyIs(key, keyLen, "exception")) {
+            bool firstMember = true;
+            while (jsonNextMember(body, firstMember, key, keyLen)) {
+                if (keyIs(key, keyLen, "type"))
+                    exceptionType = jsonString(body);
+                else if (keyIs(key, keyLen, "signal"))
+                    exceptionSignal = jsonString(body);
+                else if (keyIs(key, keyLen, "codes"))
+                    summary.exceptionCodes = jsonString(body);
+                else
+                    jsonSkipValue(body);
+            }
+        } else if (keyIs(key, keyLen, "threads")) {
+            // Only the frames of the crashed thread are kept. If we know
+            // which one that is, the frames of the others aren't even
+            // decoded; otherwise, they are dropped as soon as the thread
+            // turns out not to have crashed.
+            bool firstThread = true;
+            for (int thread = 0; jsonNextElement(body, firstThread); thread++) {
+                QVector<CrashLogFrame> frames;
+                QVector<int> indexes;
+                bool triggered = false;
+                bool firstMember = true;
+                while (jsonNextMember(body, firstMember, key, keyLen)) {
+                    if (keyIs(key, keyLen, "triggered"))
+                        triggered = jsonBool(body);
+                    else if (keyIs(key, keyLen, "frames") && summary.crashedThread < 0 && (faultingThread < 0 || thread == faultingThread))
+                        parseIpsFrames(body, frames, indexes);
+                    else
+                        jsonSkipValue(body);
+                }
+                if (summary.crashedThread < 0 && (triggered || thread == faultingThread)) {
+                    summary.crashedThread = thread;
+                    summary.frames = frames;
+                    imageIndexes = indexes;
+                }
+            }
+        } else if (keyIs(key, keyLen, "usedImages")) {
+            parseIpsImages(body, summary.images);
+        } else {
+            jsonSkipValue(body);
+        }
+    }
+
+    if (! appVersion.isEmpty())
+        summary.version = buildVersion.isEmpty() ? appVersion : appVersion + " (" + buildVersion + ")";
+    if (! exceptionType.isEmpty())
+        summary.exceptionType = exceptionSignal.isEmpty() ? exceptionType : exceptionType + " (" + exceptionSignal + ")";
+
+    // Frames refer to images by index, and the images usually come after
+    // the threads, so frames can only be resolved now.
+    for (int i = 0; i < summary.frames.count(); i++) {
+        CrashLogFrame &frame = summary.frames[i];
+        int index = imageIndexes.at(i);
+        if (index < 0 || index >= summary.images.count())
+            continue;
+        const CrashLogImage &image = summary.images.at(index);
+        frame.image = image.name;
+        if (frame.symbol.isEmpty())
+            frame.symbol = "0x" + QByteArray::number(image.base, 16) + " + " + QByteArray::number(frame.address);
+        frame.address += image.base;
+    }
+}
+
+// Parse the crash log at 'path' into 'summary'. Returns false if the
+// file could not be opened.
+bool CrashLogParser::parseFile(const QString &path, CrashLogSummary &summary) {
+    QFile f(path);
+    if (! f.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 size = f.size();
+    uchar *mapped = size > 0 ? f.map(0, size) : NULL;
+    if (mapped) {
+        parse(reinterpret_cast<const char *>(mapped), size, summary);
+        f.unmap(mapped);
+    } else {
+        QByteArray data = f.readAll();
+        parse(data.constData(), data.size(), summary);
+    }
+
+    f.close();
+    return true;
+}
+
+// Parse 'len' bytes of crash log at 'data' into 'summary'.
+void CrashLogParser::parse(const char *data, qint64 len, CrashLogSummary &summary) {
+    enum Section { HeaderSection, ThreadSection, CrashedThreadSection, ImagesSection };
+    static const char ThreadPrefix[] = "Thread ";
+    static const char CrashedSuffix[] = " Crashed:";
+    static const char ImagesHeader[] = "Binary Images:";
+
+    Section section = HeaderSection;
+    const char *p = data;
+    const char *end = data + len;
+
+    // .ips reports start with their JSON header.
+    const char *first = p;
+    while (first < end && (isBlank(*first) || *first == '\r' || *first == '\n'))
+        ++first;
+    if (first < end && *first == '{') {
+        parseIps(first, end - first, summary);
+        return;
+    }
+    while (p < end) {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (! eol)
+            eol = end;
+        const char *lineEnd = eol;
+        if (lineEnd > p && lineEnd[-1] == '\r')
+            --lineEnd;
+
+        if (lineEnd == p) {
+            // A blank line ends the crashed thread's backtrace.
+            if (section == CrashedThreadSection)
+                section = ThreadSection;
+        } else if (section == ImagesSection) {
+            CrashLogImage image;
+            if (parseImageLine(p, lineEnd, image))
+                summary.images.append(image);
+        } else if (startsWith(p, lineEnd, ThreadPrefix, sizeof(ThreadPrefix) - 1)) {
+            // 'Thread 0 Crashed:' starts the backtrace we're after. Other
+            // thread headers (and the thread state) start sections we skip.
+            int suffixLen = sizeof(CrashedSuffix) - 1;
+            if (lineEnd - p > suffixLen && memcmp(lineEnd - suffixLen, CrashedSuffix, suffixLen) == 0)
+                section = CrashedThreadSection;
+            else
+                section = ThreadSection;
+        } else if (startsWith(p, lineEnd, ImagesHeader, sizeof(ImagesHeader) - 1)) {
+            section = ImagesSection;
+        } else if (section == CrashedThreadSection) {
+            CrashLogFrame frame;
+            if (parseFrameLine(p, lineEnd, frame))
+                summary.frames.append(frame);
+        } else if (section == HeaderSection) {
+            parseHeaderLine(p, lineEnd, summary);
+        }
+
+        p = eol + 1;
+    }
+}
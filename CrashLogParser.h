@@ -0,0 +1,97 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __CRASHLOGPARSER_H__
+#define __CRASHLOGPARSER_H__
+
+#include <QtCore/QtCore>
+
+// A frame of the crashed thread's backtrace.
+struct CrashLogFrame {
+    int index;
+    QByteArray image;
+    quint64 address;
+    QByteArray symbol;
+};
+
+// An entry of the Binary Images table.
+struct CrashLogImage {
+    quint64 base;
+    quint64 end;
+    QByteArray name;
+    QByteArray arch;
+    QByteArray uuid;
+    QByteArray path;
+};
+
+// The interesting parts of an Apple .crash log (or .ips report).
+struct CrashLogSummary {
+    QByteArray incidentIdentifier;
+    QByteArray hardwareModel;
+    QByteArray osVersion;
+    QByteArray version;
+    QByteArray dateTime;
+    QByteArray exceptionType;
+    QByteArray exceptionCodes;
+    int crashedThread;
+    QVector<CrashLogFrame> frames;
+    QVector<CrashLogImage> images;
+
+    CrashLogSummary();
+    QByteArray signature(int depth = 5) const;
+    QVariantMap toVariantMap() const;
+};
+
+// A single-pass parser for Apple .crash logs.
+//
+// The log is memory mapped (or read in one go, if mapping fails) and
+// scanned for line breaks with memchr(). Lines are never copied; only
+// the fields we're after are, once they have been found. Header lines
+// are matched against a table of known keys, and everything else is
+// ignored, apart from the crashed thread's backtrace and the Binary
+// Images table.
+//
+// Newer iOS versions write .ips reports instead: a single line of JSON
+// header, followed by a JSON body. These are recognized by their leading
+// '{', and pulled apart by a streaming scan over the same mapped buffer.
+// No document is built; values we're not after are skipped without being
+// decoded, and only the crashed thread's frames are kept.
+class CrashLogParser {
+    protected:
+        static void parseIps(const char *data, qint64 len, CrashLogSummary &summary);
+        static void parseHeaderLine(const char *line, const char *end, CrashLogSummary &summary);
+        static bool parseFrameLine(const char *line, const char *end, CrashLogFrame &frame);
+        static bool parseImageLine(const char *line, const char *end, CrashLogImage &image);
+
+    public:
+        static bool parseFile(const QString &path, CrashLogSummary &summary);
+        static void parse(const char *data, qint64 len, CrashLogSummary &summary);
+};
+
+#endif
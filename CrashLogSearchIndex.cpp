@@ -0,0 +1,351 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CrashLogSearchIndex.h"
+
+#include <QtGui/QtGui>
+
+#include <algorithm>
+#include <string.h>
+
+static const char SearchIndexMagic[4] = { 'M', 'C', 'S', 'I' };
+static const quint32 SearchIndexVersion = 1;
+static const int MaxTokenLength = 128;
+
+QDataStream &operator<<(QDataStream &out, const SearchDocument &doc) {
+    return out << doc.path << doc.size << doc.mtime;
+}
+
+QDataStream &operator>>(QDataStream &in, SearchDocument &doc) {
+    return in >> doc.path >> doc.size >> doc.mtime;
+}
+
+CrashLogSearchIndex::CrashLogSearchIndex(const QString &path) {
+    qsPath = path;
+    iNextDocId = 0;
+    iDeadDocs = 0;
+    bDirty = false;
+    load();
+}
+
+CrashLogSearchIndex::~CrashLogSearchIndex() {
+    save();
+}
+
+// Get the path of the on-disk search index.
+QString CrashLogSearchIndex::defaultIndexPath() {
+    QString path = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+    QDir d;
+    d.mkpath(path);
+    return QDir(path).absoluteFilePath(QLatin1String("CrashLogSearch.idx"));
+}
+
+void CrashLogSearchIndex::load() {
+    QFile f(qsPath);
+    if (! f.exists())
+        return;
+
+    if (! f.open(QIODevice::ReadOnly)) {
+        qWarning("CrashLogSearchIndex: Unable to open index for reading.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[4];
+    quint32 version = 0;
+    if (qds.readRawData(magic, 4) != 4 || memcmp(magic, SearchIndexMagic, 4) != 0) {
+        qWarning("CrashLogSearchIndex: Index has bad magic. Ignoring.");
+        return;
+    }
+    qds >> version;
+    if (version != SearchIndexVersion) {
+        qWarning("CrashLogSearchIndex: Unknown index version %u. Ignoring.", version);
+        return;
+    }
+
+    quint32 deadDocs = 0;
+    qds >> iNextDocId >> deadDocs >> qhDocs >> qvTokens >> qvPostings;
+    if (qds.status() != QDataStream::Ok || qvTokens.count() != qvPostings.count()) {
+        qWarning("CrashLogSearchIndex: Index is corrupt. Ignoring.");
+        iNextDocId = 0;
+        qhDocs.clear();
+        qvTokens.clear();
+        qvPostings.clear();
+        return;
+    }
+    iDeadDocs = static_cast<int>(deadDocs);
+
+    QHash<quint32, SearchDocument>::const_iterator it;
+    for (it = qhDocs.constBegin(); it != qhDocs.constEnd(); ++it)
+        qhDocIds.insert(it.value().path, it.key());
+    for (int i = 0; i < qvTokens.count(); i++)
+        qhTokenIds.insert(qvTokens.at(i), static_cast<quint32>(i));
+
+    f.close();
+}
+
+// Write the index to disk, if it has changed since it was loaded.
+void CrashLogSearchIndex::save() {
+    QMutexLocker lock(&qmLock);
+    if (! bDirty)
+        return;
+
+    QFile f(qsPath);
+    if (! f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("CrashLogSearchIndex: Unable to open index for writing.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+    qds.writeRawData(SearchIndexMagic, 4);
+    qds << SearchIndexVersion;
+    qds << iNextDocId << static_cast<quint32>(iDeadDocs) << qhDocs << qvTokens << qvPostings;
+
+    f.close();
+    bDirty = false;
+}
+
+static inline bool isTokenChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+static inline bool isLetter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Split 'len' bytes at 'data' into the set of distinct tokens they contain.
+QSet<QByteArray> CrashLogSearchIndex::tokenize(const char *data, qint64 len) {
+    QSet<QByteArray> tokens;
+    const char *p = data;
+    const char *end = data + len;
+    while (p < end) {
+        while (p < end && ! isTokenChar(*p))
+            ++p;
+
+        const char *start = p;
+        bool letter = false;
+        for (; p < end && isTokenChar(*p); ++p) {
+            if (isLetter(*p))
+                letter = true;
+        }
+
+        // Dots only join words, as in 'libobjc.A.dylib' or '1.2.1'.
+        const char *stop = p;
+        while (start < stop && *start == '.')
+            ++start;
+        while (stop > start && stop[-1] == '.')
+            --stop;
+
+        int n = stop - start;
+        if (! letter || n < 2 || n > MaxTokenLength)
+            continue;
+        if (start[0] == '0' && (start[1] == 'x' || start[1] == 'X'))
+            continue;
+        tokens.insert(QByteArray(start, n).toLower());
+    }
+    return tokens;
+}
+
+// Tokenize the file at 'path'. Unreadable files have no tokens.
+QSet<QByteArray> CrashLogSearchIndex::tokenizeFile(const QString &path) {
+    QFile f(path);
+    if (! f.open(QIODevice::ReadOnly))
+        return QSet<QByteArray>();
+
+    QSet<QByteArray> tokens;
+    qint64 size = f.size();
+    uchar *mapped = size > 0 ? f.map(0, size) : NULL;
+    if (mapped) {
+        tokens = tokenize(reinterpret_cast<const char *>(mapped), size);
+        f.unmap(mapped);
+    } else {
+        QByteArray data = f.readAll();
+        tokens = tokenize(data.constData(), data.size());
+    }
+    f.close();
+    return tokens;
+}
+
+// The key by which a log that has moved is recognized: its device (the
+// name of the directory it is in), file name, size and modification time.
+static QString movedLogKey(const QFileInfo &fi, qint64 size, uint mtime) {
+    return QString::fromLatin1("%1/%2/%3/%4").arg(fi.dir().dirName()).arg(fi.fileName()).arg(size).arg(mtime);
+}
+
+// Bring the index up to date with the crash logs at 'paths'. Logs that are
+// not in 'paths' are dropped from the index, and logs that are new to it
+// are read and added, unless they turn out to be logs that have moved.
+void CrashLogSearchIndex::update(const QStringList &paths) {
+    QSet<QString> current = QSet<QString>::fromList(paths);
+    // Several logs that are gone may share a key (a device that was
+    // backed up twice, say), so each keeps its own entry.
+    QMultiHash<QString, quint32> gone;
+    QStringList added;
+
+    {
+        QMutexLocker lock(&qmLock);
+        QHash<QString, quint32>::iterator it = qhDocIds.begin();
+        while (it != qhDocIds.end()) {
+            if (current.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            const SearchDocument &doc = qhDocs[it.value()];
+            gone.insert(movedLogKey(QFileInfo(doc.path), doc.size, doc.mtime), it.value());
+            it = qhDocIds.erase(it);
+            bDirty = true;
+        }
+        foreach (QString path, paths) {
+            if (! qhDocIds.contains(path))
+                added << path;
+        }
+    }
+
+    foreach (QString path, added) {
+        QFileInfo fi(path);
+        SearchDocument doc;
+        doc.path = path;
+        doc.size = fi.size();
+        doc.mtime = fi.lastModified().toTime_t();
+
+        // A log that has moved keeps its ID, and its tokens.
+        QMultiHash<QString, quint32>::iterator g = gone.find(movedLogKey(fi, doc.size, doc.mtime));
+        if (g != gone.end()) {
+            quint32 id = g.value();
+            gone.erase(g);
+            QMutexLocker lock(&qmLock);
+            qhDocs.insert(id, doc);
+            qhDocIds.insert(path, id);
+            continue;
+        }
+
+        // Read the log without holding the lock, so searches can go on.
+        QSet<QByteArray> tokens = tokenizeFile(path);
+
+        QMutexLocker lock(&qmLock);
+        quint32 id = iNextDocId++;
+        qhDocs.insert(id, doc);
+        qhDocIds.insert(path, id);
+        foreach (QByteArray token, tokens) {
+            quint32 tokenId;
+            QHash<QByteArray, quint32>::const_iterator t = qhTokenIds.constFind(token);
+            if (t != qhTokenIds.constEnd()) {
+                tokenId = t.value();
+            } else {
+                tokenId = static_cast<quint32>(qvTokens.count());
+                qvTokens.append(token);
+                qhTokenIds.insert(token, tokenId);
+                qvPostings.append(QVector<quint32>());
+            }
+            // IDs only ever grow, so the list stays sorted.
+            qvPostings[tokenId].append(id);
+        }
+        bDirty = true;
+    }
+
+    QMutexLocker lock(&qmLock);
+    foreach (quint32 id, gone) {
+        qhDocs.remove(id);
+        iDeadDocs++;
+    }
+    if (iDeadDocs > qhDocs.count())
+        compact();
+}
+
+// Purge the IDs of logs that are no longer in the index from the token
+// lists. The caller must hold qmLock.
+void CrashLogSearchIndex::compact() {
+    for (int i = 0; i < qvPostings.count(); i++) {
+        const QVector<quint32> &postings = qvPostings.at(i);
+        QVector<quint32> live;
+        live.reserve(postings.count());
+        foreach (quint32 id, postings) {
+            if (qhDocs.contains(id))
+                live.append(id);
+        }
+        qvPostings[i] = live;
+    }
+    iDeadDocs = 0;
+    bDirty = true;
+}
+
+static bool postingsShorterThan(const QVector<quint32> *a, const QVector<quint32> *b) {
+    return a->count() < b->count();
+}
+
+// Find the crash logs containing all tokens of 'query'. Returns the paths of
+// at most 'limit' logs (or all of them, if 'limit' isn't positive), most
+// recently indexed first.
+QStringList CrashLogSearchIndex::search(const QString &query, int limit) {
+    QByteArray q = query.toUtf8();
+    QSet<QByteArray> tokens = tokenize(q.constData(), q.size());
+    if (tokens.isEmpty())
+        return QStringList();
+
+    QMutexLocker lock(&qmLock);
+
+    QList<const QVector<quint32> *> lists;
+    foreach (QByteArray token, tokens) {
+        QHash<QByteArray, quint32>::const_iterator t = qhTokenIds.constFind(token);
+        if (t == qhTokenIds.constEnd())
+            return QStringList();
+        lists << &qvPostings.at(t.value());
+    }
+
+    // Intersect, starting from the shortest list. The candidates are
+    // few by then, so they are looked up in the longer lists by binary
+    // search.
+    qSort(lists.begin(), lists.end(), postingsShorterThan);
+    QVector<quint32> matches = *lists.first();
+    for (int i = 1; i < lists.count() && ! matches.isEmpty(); i++) {
+        const QVector<quint32> *list = lists.at(i);
+        QVector<quint32> remaining;
+        foreach (quint32 id, matches) {
+            if (std::binary_search(list->constBegin(), list->constEnd(), id))
+                remaining.append(id);
+        }
+        matches = remaining;
+    }
+
+    QStringList paths;
+    for (int i = matches.count() - 1; i >= 0; i--) {
+        QHash<quint32, SearchDocument>::const_iterator it = qhDocs.constFind(matches.at(i));
+        if (it == qhDocs.constEnd())
+            continue;
+        paths << it.value().path;
+        if (limit > 0 && paths.count() >= limit)
+            break;
+    }
+    return paths;
+}
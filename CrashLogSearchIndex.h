@@ -0,0 +1,89 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __CRASHLOGSEARCHINDEX_H__
+#define __CRASHLOGSEARCHINDEX_H__
+
+#include <QtCore/QtCore>
+
+// A crash log known to the search index.
+struct SearchDocument {
+    QString path;
+    qint64 size;
+    uint mtime;
+};
+
+// A persistent inverted index of the tokens in the crash logs, for finding
+// every log that mentions a given symbol, exception or image.
+//
+// Tokens are runs of letters, digits, '_' and '.', folded to lower case.
+// Tokens without any letters (addresses, offsets, line numbers) are left
+// out, since they are plentiful and not worth searching for. For each
+// token, the index keeps a sorted list of the IDs of the logs containing
+// it. A query is the intersection of the lists of its tokens.
+//
+// The index is maintained incrementally by update(). Crash logs are written
+// once, so only logs that have appeared are read. A log that has merely
+// been moved (such as into the submitted logs directory) keeps its ID.
+// Logs that have disappeared are dropped from the document table right
+// away, but their IDs are only purged from the token lists once they
+// make up half of the index.
+//
+// update() and search() may be called from worker threads. Only one
+// update() may run at a time; searches can run alongside it.
+class CrashLogSearchIndex {
+    protected:
+        QMutex qmLock;
+        QString qsPath;
+        quint32 iNextDocId;
+        int iDeadDocs;
+        bool bDirty;
+        QHash<quint32, SearchDocument> qhDocs;
+        QHash<QString, quint32> qhDocIds;
+        QVector<QByteArray> qvTokens;
+        QHash<QByteArray, quint32> qhTokenIds;
+        QVector<QVector<quint32> > qvPostings;
+        void load();
+        void compact();
+        static QSet<QByteArray> tokenize(const char *data, qint64 len);
+        static QSet<QByteArray> tokenizeFile(const QString &path);
+
+    public:
+        CrashLogSearchIndex(const QString &path = CrashLogSearchIndex::defaultIndexPath());
+        ~CrashLogSearchIndex();
+        void update(const QStringList &paths);
+        QStringList search(const QString &query, int limit);
+        void save();
+        static QString defaultIndexPath();
+};
+
+QDataStream &operator<<(QDataStream &out, const SearchDocument &doc);
+QDataStream &operator>>(QDataStream &in, SearchDocument &doc);
+
+#endif
@@ -53,6 +53,7 @@ CrashReporter::CrashReporter(QWidget *parent) : QMainWindow(parent) {
 
     // New log finder
     lhLogHandler = new LogHandler(this);
+    lhLogHandler->startBackgroundWork();
 
     // Page load progress bar
     qpbProgressBar = new QProgressBar(this);
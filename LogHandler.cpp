@@ -28,29 +28,300 @@
 */
 
 #include "LogHandler.h"
+#include "Settings.h"
+#include "CompressionHelper.h"
+#include "CrashLogParser.h"
+#include "Symbolicator.h"
 
 #include <QtGui/QtGui>
 
 #include <stdlib.h>
 
-LogHandler::LogHandler(QObject *p) : QObject(p) {
-    qsCrashLogDir = LogHandler::crashLogDirectory();
+LogHandler::LogHandler(QObject *p) : QObject(p), cfcrPreview(8192, PreviewHandleBase) {
+    qslCrashLogDirs = LogHandler::crashLogDirectories();
+    qslApplications = Settings::get()->crashLogApplications();
     qsSubmittedCrashLogDir = LogHandler::submittedCrashLogDirectory();
+    Symbolicator::setSymbolsDirectory(Settings::get()->symbolsDirectory());
+    cfcrPreview.setBudget(Settings::get()->previewCacheSize());
     qnamAccessManager = NULL;
     sState = LogHandler::Ready;
+    iNextLog = 0;
+    iFinishedLogs = 0;
+    iMaxInFlight = 1;
+    bBatchUploads = false;
+    iBatchMaxLogs = 1;
+    iBatchMaxBytes = 0;
+    bRepresentatives = false;
+    iRepresentatives = 1;
+    ueEncoding = PlainEncoding;
+    qnrNegotiation = NULL;
+    qfwSubmitScan = NULL;
+    iBytesDone = 0;
+    iBytesPending = 0;
+    utThrottle = new UploadThrottle(this);
+    utThrottle->setRate(qint64(Settings::get()->uploadRateLimit()) * 1024);
+    qbaDictionary = CompressionHelper::loadPresetDictionary();
+    if (! qbaDictionary.isEmpty())
+        qsDictionaryId = CompressionHelper::dictionaryId(qbaDictionary);
+    qelLoop = NULL;
+    qpdProgress = NULL;
+    QObject::connect(this, SIGNAL(submitProgress(int, int, qint64, qint64)), this, SLOT(progressDialogProgress(int, int, qint64, qint64)));
+    QObject::connect(this, SIGNAL(submitFinished(int, int, bool)), this, SLOT(progressDialogFinished(int, int, bool)));
+
+    ueRetryEncoding = preferredEncoding();
+    qtRetryTimer = new QTimer(this);
+    qtRetryTimer->setSingleShot(true);
+    QObject::connect(qtRetryTimer, SIGNAL(timeout()), this, SLOT(drainRetryQueue()));
+
+    iNextHandle = 1;
+    bDryRun = false;
+    bBackgroundWork = false;
+    qfwIndexing = NULL;
+    bIndexPending = false;
+    qfwWatchScan = NULL;
+    bWatchPrimed = false;
+    bRescanPending = false;
+
+    // Changes to the crash log directory tend to come in bursts (iTunes
+    // syncing a device drops many logs at once), so they are collected
+    // and acted upon once things have settled down.
+    qfswWatcher = new QFileSystemWatcher(this);
+    qtRescanTimer = new QTimer(this);
+    qtRescanTimer->setSingleShot(true);
+    qtRescanTimer->setInterval(500);
+    QObject::connect(qfswWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(crashLogDirectoryChanged(QString)));
+    QObject::connect(qtRescanTimer, SIGNAL(timeout()), this, SLOT(rescanCrashLogDirectory()));
 }
 
 LogHandler::~LogHandler() {
+    // Scans, reads and archive moves running on worker threads may
+    // still be using the manifest.
+    QThreadPool::globalInstance()->waitForDone();
 }
 
 void LogHandler::setNetworkAccessManager(QNetworkAccessManager *qnam) {
     qnamAccessManager = qnam;
+    if (bBackgroundWork)
+        scheduleRetry();
 }
 
 QNetworkAccessManager *LogHandler::networkAccessManager() const {
     return qnamAccessManager;
 }
 
+// Start the work that keeps going for as long as we run: watching the crash
+// log directories, keeping the search index and catalog up to date, and
+// retrying failed submissions. Only the windowed crash reporter wants these;
+// the command line modes do one thing and quit, and shouldn't have to wait
+// for the search index to be rebuilt first.
+void LogHandler::startBackgroundWork() {
+    if (bBackgroundWork)
+        return;
+
+    bBackgroundWork = true;
+    watchCrashLogDirectory();
+    updateSearchIndex();
+    scheduleRetry();
+}
+
+// Scan the crash log directories, and look up the catalog entry of every
+// crash log found, parsing those that are new to the catalog right away.
+// The scan's 'entries' hold the results. This blocks until done, and is
+// meant for the command line modes, which have no window to keep responsive.
+CrashLogScan LogHandler::scanCrashLogCatalog() {
+    CrashLogScanRequest request;
+    request.crashLogDirs = qslCrashLogDirs;
+    request.applications = qslApplications;
+    request.stamps = false;
+    request.hashes = false;
+    request.signatures = false;
+    request.catalog = &clcCatalog;
+    request.cachedEntries = false;
+
+    CrashLogScan scan = scanCrashLogs(&clmManifest, request);
+    applyCrashLogScan(scan);
+    clcCatalog.save();
+    return scan;
+}
+
+// In a dry run, a submit stops once it knows which crash logs it would
+// upload: crashLogQueued() is emitted for each of them, and nothing is
+// uploaded, archived or queued for retry.
+void LogHandler::setDryRun(bool b) {
+    bDryRun = b;
+}
+
+// Start watching the crash log directories. Their device directories are
+// watched as soon as the initial scan has found them.
+void LogHandler::watchCrashLogDirectory() {
+    if (qslCrashLogDirs.isEmpty())
+        return;
+
+    qfswWatcher->addPaths(qslCrashLogDirs);
+    rescanCrashLogDirectory();
+}
+
+// Called by the file system watcher whenever a watched directory changes.
+// Restarts the rescan timer, so a burst of changes only results in a
+// single rescan.
+void LogHandler::crashLogDirectoryChanged(const QString &path) {
+    qsetChangedDirs.insert(path);
+    qtRescanTimer->start();
+}
+
+// Rescan the directories that have changed since the last rescan, on a
+// worker thread. Only one rescan runs at a time; changes that come in
+// while it runs are picked up by another rescan once it has finished.
+void LogHandler::rescanCrashLogDirectory() {
+    if (qfwWatchScan) {
+        bRescanPending = true;
+        return;
+    }
+
+    CrashLogScanRequest request;
+    request.crashLogDirs = qslCrashLogDirs;
+    request.applications = qslApplications;
+    request.knownDevices = QSet<QString>::fromList(qhKnownLogs.keys());
+    foreach (QString path, qsetChangedDirs) {
+        if (! qslCrashLogDirs.contains(path))
+            request.dirtyDevices.insert(QFileInfo(path).fileName());
+    }
+    request.stamps = true;
+    request.hashes = false;
+    request.signatures = false;
+    request.catalog = NULL;
+    request.cachedEntries = false;
+    qsetChangedDirs.clear();
+
+    qfwWatchScan = new QFutureWatcher<CrashLogScan>(this);
+    QObject::connect(qfwWatchScan, SIGNAL(finished()), this, SLOT(watchScanFinished()));
+    qfwWatchScan->setFuture(QtConcurrent::run(&LogHandler::scanCrashLogs, &clmManifest, request));
+}
+
+// Called when a rescan started by rescanCrashLogDirectory() has finished.
+// Emits signals for the devices and crash logs that have come and gone.
+// The initial scan only takes note of what is there.
+void LogHandler::watchScanFinished() {
+    CrashLogScan scan = qfwWatchScan->result();
+    qfwWatchScan->deleteLater();
+    qfwWatchScan = NULL;
+
+    // Watch the device directories that have appeared, and stop watching
+    // those that have gone away. A device may have a directory in more than
+    // one crash log directory.
+    QSet<QString> oldDirs, newDirs;
+    foreach (QStringList dirs, qhDeviceDirs)
+        oldDirs += QSet<QString>::fromList(dirs);
+    foreach (QStringList dirs, scan.deviceDirs)
+        newDirs += QSet<QString>::fromList(dirs);
+    foreach (QString dir, oldDirs - newDirs)
+        qfswWatcher->removePath(dir);
+    foreach (QString dir, newDirs - oldDirs)
+        qfswWatcher->addPath(dir);
+
+    applyCrashLogScan(scan);
+
+    foreach (QString device, qhKnownLogs.keys()) {
+        if (scan.devices.contains(device))
+            continue;
+        diffCrashLogStamps(device, QHash<QString, CrashLogStamp>());
+        qhKnownLogs.remove(device);
+        if (bWatchPrimed)
+            emit crashDeviceRemoved(device);
+    }
+
+    foreach (QString device, scan.devices) {
+        if (! qhKnownLogs.contains(device)) {
+            if (bWatchPrimed)
+                emit crashDeviceAdded(device);
+        }
+        if (scan.stamps.contains(device))
+            diffCrashLogStamps(device, scan.stamps.value(device));
+    }
+
+    bWatchPrimed = true;
+    if (bRescanPending) {
+        bRescanPending = false;
+        qtRescanTimer->start();
+    }
+
+    updateSearchIndex();
+}
+
+// Bring the search index up to date on a worker thread. Only one update
+// runs at a time; another one is started right after it if asked for in
+// the meantime.
+void LogHandler::updateSearchIndex() {
+    if (! bBackgroundWork)
+        return;
+
+    if (qfwIndexing) {
+        bIndexPending = true;
+        return;
+    }
+
+    CrashLogIndexRequest request;
+    request.manifest = &clmManifest;
+    request.index = &csiSearch;
+    request.catalog = &clcCatalog;
+    request.cachedEntries = false;
+    request.crashLogDirs = qslCrashLogDirs;
+    request.applications = qslApplications;
+    request.submittedDir = qsSubmittedCrashLogDir;
+
+    qfwIndexing = new QFutureWatcher<void>(this);
+    QObject::connect(qfwIndexing, SIGNAL(finished()), this, SLOT(searchIndexUpdated()));
+    qfwIndexing->setFuture(QtConcurrent::run(&LogHandler::indexCrashLogs, request));
+}
+
+// Called when an update started by updateSearchIndex() has finished.
+void LogHandler::searchIndexUpdated() {
+    qfwIndexing->deleteLater();
+    qfwIndexing = NULL;
+    emit crashLogCatalogUpdated();
+
+    if (bIndexPending) {
+        bIndexPending = false;
+        updateSearchIndex();
+    }
+}
+
+// Update 'index' with the crash logs in both the crash log directories and
+// the submitted logs directory, and 'catalog' with the crash logs in the
+// crash log directories. This runs on a worker thread.
+void LogHandler::indexCrashLogs(const CrashLogIndexRequest &request) {
+    QStringList pending = listCrashLogs(request.manifest, request.crashLogDirs, request.applications).paths.values();
+    QStringList submitted = listCrashLogs(request.manifest, QStringList() << request.submittedDir, request.applications).paths.values();
+
+    request.index->update(pending + submitted);
+    request.index->save();
+    request.catalog->update(pending);
+    request.catalog->save();
+    request.manifest->save();
+}
+
+// Compare the crash logs of a device against what we knew about them, and
+// emit signals for the differences.
+void LogHandler::diffCrashLogStamps(const QString &deviceName, const QHash<QString, CrashLogStamp> &stamps) {
+    QHash<QString, CrashLogStamp> oldStamps = qhKnownLogs.value(deviceName);
+    qhKnownLogs.insert(deviceName, stamps);
+    if (! bWatchPrimed)
+        return;
+
+    QHash<QString, CrashLogStamp>::const_iterator i;
+    for (i = oldStamps.constBegin(); i != oldStamps.constEnd(); ++i) {
+        if (! stamps.contains(i.key()))
+            emit crashLogRemoved(deviceName, i.key());
+    }
+
+    for (i = stamps.constBegin(); i != stamps.constEnd(); ++i) {
+        if (! oldStamps.contains(i.key()))
+            emit crashLogAdded(deviceName, i.key());
+        else if (oldStamps.value(i.key()) != i.value())
+            emit crashLogChanged(deviceName, i.key());
+    }
+}
+
 void LogHandler::showSubmittedCrashLogs() {
     QString fileName = LogHandler::submittedCrashLogDirectory();
     QFile f(fileName);
@@ -89,8 +360,11 @@ void LogHandler::deleteSubmittedCrashLogs() {
     }
 }
 
-QString LogHandler::crashLogDirectory() {
-    QStringList possiblePaths;
+// Get the directories to look for device crash logs in: the ones configured in the
+// settings, followed by the platform's default ones. Only directories that exist
+// are returned, and each of them only once.
+QStringList LogHandler::crashLogDirectories() {
+    QStringList possiblePaths = Settings::get()->crashLogDirectories();
 #if defined(Q_OS_WIN)
     QString username;
     wchar_t *envvar = _wgetenv(L"username");
@@ -103,13 +377,12 @@ QString LogHandler::crashLogDirectory() {
         appdata.replace(QChar('\\'), QChar('/'));
     }
 
-    if (username.isEmpty())
-        return QString();
-
     // These first two are the paths provided by Apple in their documentation. In addition,
     // we query %APPDATA%, and check that as well, in case something weird is going on.
-    possiblePaths << QString::fromLatin1("C:/Documents and Settings/%1/Application Data/Apple Computer/Logs/CrashReporter/MobileDevice").arg(username);
-    possiblePaths << QString::fromLatin1("C:/Users/%1/AppData/Roaming/Apple Computer/Logs/CrashReporter/MobileDevice").arg(username);
+    if (! username.isEmpty()) {
+        possiblePaths << QString::fromLatin1("C:/Documents and Settings/%1/Application Data/Apple Computer/Logs/CrashReporter/MobileDevice").arg(username);
+        possiblePaths << QString::fromLatin1("C:/Users/%1/AppData/Roaming/Apple Computer/Logs/CrashReporter/MobileDevice").arg(username);
+    }
     if (! appdata.isEmpty())
         possiblePaths << QString::fromLatin1("%1/Apple Computer/Logs/CrashReporter/MobileDevice").arg(appdata);
 #elif defined(Q_OS_MAC)
@@ -120,13 +393,26 @@ QString LogHandler::crashLogDirectory() {
 
     possiblePaths << QString::fromLatin1("%1/Library/Logs/CrashReporter/MobileDevice").arg(homeDir);
     possiblePaths << QString::fromLatin1("%1/Library/Logs/DiagnosticReports/MobileDevice").arg(homeDir);
+#else
+    // There's no iTunes here. Crash logs pulled off devices with libimobiledevice's
+    // idevicecrashreport are expected in a MobileDevice directory in our data
+    // directory, laid out like the iTunes one (one subdirectory per device).
+    possiblePaths << QDir(QDesktopServices::storageLocation(QDesktopServices::DataLocation)).absoluteFilePath(QLatin1String("MobileDevice"));
 #endif
+    QStringList paths;
+    QSet<QString> seen;
     foreach (QString path, possiblePaths) {
-        if (QFile::exists(path))
-            return path;
+        QFileInfo fi(path);
+        if (! fi.isDir())
+            continue;
+        QString canonical = fi.canonicalFilePath();
+        if (seen.contains(canonical))
+            continue;
+        seen.insert(canonical);
+        paths << fi.absoluteFilePath();
     }
 
-    return QString();
+    return paths;
 }
 
 // Get the path of the 'submitted log directory', i.e. the directory where we copy
@@ -145,69 +431,101 @@ QString LogHandler::submittedCrashLogDirectory() {
 //
 // Callable from JavaScript.
 QStringList LogHandler::availableCrashReporterDevices() {
-    if (qsCrashLogDir.isEmpty())
+    if (qslCrashLogDirs.isEmpty())
         return QStringList();
 
-    QDir d(qsCrashLogDir);
-
-    // Update the list of safe devices.
-    QStringList availDevs = d.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-
-    // Don't include .symbolicated devices.
-    qslSafeDeviceNames.clear();
-    foreach (QString dev, availDevs) {
-        if (dev.endsWith(QLatin1String(".symbolicated")))
-            continue;
-        qslSafeDeviceNames << dev;
+    QStringList deviceNames;
+    QHash<QString, QStringList> deviceDirs;
+    foreach (QString dir, qslCrashLogDirs) {
+        QDir d(dir);
+        foreach (QString device, crashReporterDevices(&clmManifest, dir)) {
+            if (! deviceDirs.contains(device))
+                deviceNames << device;
+            deviceDirs[device] << d.filePath(device);
+        }
     }
 
-    return qslSafeDeviceNames;
+    // Update the list of safe devices.
+    qsetSafeDeviceNames = QSet<QString>::fromList(deviceNames);
+    qhDeviceDirs = deviceDirs;
+    return deviceNames;
 }
 
-// Get a list of the available crash reports for a particular device. This lists the files of a
-// device directory in hte iTunes crash report directory that match a particular pattern (in this
-// case, we're only interested in the iOS crash logs for 'Mumble').
+// Get a list of the available crash reports for a particular device. This lists the files of the
+// device's directories in the crash report directories that match a particular pattern (in this
+// case, we're only interested in the iOS crash logs for the apps in the settings, 'Mumble' by
+// default).
 //
 // Callable from JavaScript.
 QStringList LogHandler::crashFilesForDevice(const QString &deviceName) {
     // Is this a safe path?
-    if (! qslSafeDeviceNames.contains(deviceName))
+    if (! qsetSafeDeviceNames.contains(deviceName))
         return QStringList();
 
-    QFileInfoList files = crashLogPathsForApplication(QLatin1String("Mumble"), deviceName);
-    QStringList fileNames;
-    foreach (QFileInfo info, files) {
-        fileNames << info.fileName();
-    }
+    CrashLogScan scan = listCrashLogs(&clmManifest, qslCrashLogDirs, qslApplications, deviceName);
+    QStringList fileNames = scan.files.value(deviceName);
 
     // Update list of safe files for this device
-    qmSafeDeviceFiles.insert(deviceName, fileNames);
+    setSafeCrashLogs(deviceName, fileNames);
+    qhDeviceDirs.insert(deviceName, scan.deviceDirs.value(deviceName));
+    QHash<DeviceLog, QString>::const_iterator i;
+    for (i = scan.paths.constBegin(); i != scan.paths.constEnd(); ++i)
+        qhLogPaths.insert(i.key(), i.value());
 
     return fileNames;
 }
 
+// Get a page of the available crash reports for a particular device, for devices with
+// too many of them to list at once. Returns a map holding the 'total' number of crash
+// reports, the 'offset' of the page, and the 'files' on it. Each file is a map holding
+// its 'file' name and a 'handle', which can be passed to contentsOfCrashHandle() and
+// friends. Handles stay the same for as long as the crash reporter runs.
+//
+// The listing is refreshed when the first page is asked for; later pages come from
+// the same listing, so they line up with each other.
+//
+// Callable from JavaScript.
+QVariantMap LogHandler::crashFilePageForDevice(const QString &deviceName, int offset, int limit) {
+    QVariantMap page;
+
+    // Is this a safe path?
+    if (! qsetSafeDeviceNames.contains(deviceName))
+        return page;
+
+    if (offset <= 0 || ! qhSafeDeviceListings.contains(deviceName))
+        crashFilesForDevice(deviceName);
+
+    const QStringList &fileNames = qhSafeDeviceListings[deviceName];
+    offset = qMax(offset, 0);
+    int end = limit > 0 ? qMin(offset + limit, fileNames.count()) : fileNames.count();
+
+    QVariantList files;
+    for (int i = offset; i < end; i++) {
+        QVariantMap file;
+        file.insert(QLatin1String("file"), fileNames.at(i));
+        file.insert(QLatin1String("handle"), handleForCrashLog(DeviceLog(deviceName, fileNames.at(i))));
+        files << QVariant(file);
+    }
+
+    page.insert(QLatin1String("total"), fileNames.count());
+    page.insert(QLatin1String("offset"), offset);
+    page.insert(QLatin1String("files"), files);
+    return page;
+}
+
 // Reads the contents of a crash file for a particular device. Returns a byte array.
 //
 // Callable from JavaScript.
 QByteArray LogHandler::contentsOfCrashFile(const QString &deviceName, const QString &fileName) const {
     // No crash log dir set? No cookie.
-    if (qsCrashLogDir.isEmpty())
+    if (qslCrashLogDirs.isEmpty())
 		return QByteArray();
 
     // Are we accessing a safe file?
-    if (! qslSafeDeviceNames.contains(deviceName) || ! qmSafeDeviceFiles[deviceName].contains(fileName))
+    if (! isSafeCrashLog(deviceName, fileName))
         return QByteArray();
 
-    QDir d(qsCrashLogDir);
-    d.cd(deviceName);
-    QString targetFile = d.filePath(fileName);
-
-    QFile f(targetFile);
-    f.open(QIODevice::ReadOnly);
-    QByteArray contents = f.readAll();
-    f.close();
-
-    return contents;
+    return readCrashFile(crashLogPath(DeviceLog(deviceName, fileName)));
 }
 
 // Reads the contents of a crash file for a particular device. Returns a properly-encoded string.
@@ -222,225 +540,1754 @@ QString LogHandler::contentsOfCrashFileAsString(const QString &deviceName, const
     return QString();
 }
 
-// Returns a QFileInfoList for all crash logs for the iOS appplication 'appName' from the device identified
-// by 'deviceName'.
-QFileInfoList LogHandler::crashLogPathsForApplication(const QString &appName, const QString &deviceName) const {
-    if (qsCrashLogDir.isEmpty())
-		return QFileInfoList();
+// Reads the contents of the crash file identified by 'handle', as handed out by
+// crashFilePageForDevice(). Returns a properly-encoded string.
+//
+// Callable from JavaScript.
+QString LogHandler::contentsOfCrashHandle(int handle) const {
+    DeviceLog log = crashLogForHandle(handle);
+    return contentsOfCrashFileAsString(log.first, log.second);
+}
+
+// Open a crash file for a particular device for reading it a chunk at a time, so the
+// page can show the start of a large crash file without pulling all of it across.
+// Returns a map holding a 'handle' for the file, its 'size' in bytes, and the number
+// of 'chunks' it has, or an empty map if it is not one of the safe files or could
+// not be opened. Chunks are read with readCrashFileChunks(), and the file should be
+// closed with closeCrashFile() when done. Only a few files are kept open at once;
+// opening more closes the ones read least recently, whose handles then read as
+// empty until the file is opened again.
+//
+// Callable from JavaScript.
+QVariantMap LogHandler::openCrashFile(const QString &deviceName, const QString &fileName) {
+    QVariantMap file;
+
+    // Are we accessing a safe file?
+    if (qslCrashLogDirs.isEmpty() || ! isSafeCrashLog(deviceName, fileName))
+        return file;
+
+    int handle = cfcrPreview.open(crashLogPath(DeviceLog(deviceName, fileName)));
+    if (! handle)
+        return file;
 
-    QDir d(qsCrashLogDir);
-    d.cd(deviceName);
-    QStringList filters;
-    filters << QString::fromLatin1("%1*.crash").arg(appName);
-    d.setNameFilters(filters);
-    return d.entryInfoList(QDir::Files | QDir::NoDotAndDotDot);
+    file.insert(QLatin1String("handle"), handle);
+    file.insert(QLatin1String("size"), cfcrPreview.size(handle));
+    file.insert(QLatin1String("chunks"), cfcrPreview.chunkCount(handle));
+    return file;
 }
 
-// List all available crash logs. This is a combination of the return value of
-// crashFilesForDevice() For all available crash reporter devices (returned by
-// availableCrashReporterDevices()).
-QList<DeviceLog> LogHandler::allCrashLogs() {
-    QList<DeviceLog> logs;
-    foreach (QString device, availableCrashReporterDevices()) {
-        foreach (QString file, crashFilesForDevice(device)) {
-            logs.push_back(QPair<QString, QString>(device, file));
-        }
-    }
-    return logs;
+// Read 'chunkCount' chunks of a crash file opened with openCrashFile(), starting at
+// chunk 'firstChunk'. Returns a properly-encoded string. Decoded chunks are cached,
+// so reading them again is cheap.
+//
+// Callable from JavaScript.
+QString LogHandler::readCrashFileChunks(int handle, int firstChunk, int chunkCount) {
+    return cfcrPreview.read(handle, firstChunk, chunkCount);
 }
 
-// Start submitting all crash logs.
+// Close a crash file opened with openCrashFile().
 //
 // Callable from JavaScript.
-void LogHandler::submitAllCrashLogs() {
-    // We can only submit if we're in the ready state.
-    if (sState != LogHandler::Ready)
-        return;
+void LogHandler::closeCrashFile(int handle) {
+    cfcrPreview.close(handle);
+}
 
-    iCurrentLog = 0;
-    qlSubmitList = allCrashLogs();
-    if (qlSubmitList.isEmpty()) {
-        QMessageBox *qmb = new QMessageBox(NULL);
-        qmb->setIcon(QMessageBox::Information);
-        qmb->setWindowTitle(QLatin1String("No logs available"));
-        qmb->setText(QLatin1String("No crash logs were found on your computer. Nothing to send."));
-        qmb->exec();
-        delete qmb;
-        return;
-    }
+// Whether the crash file 'fileName' of device 'deviceName' has been listed, and
+// may be read.
+bool LogHandler::isSafeCrashLog(const QString &deviceName, const QString &fileName) const {
+    if (! qsetSafeDeviceNames.contains(deviceName))
+        return false;
+    QHash<QString, QSet<QString> >::const_iterator it = qhSafeDeviceFiles.constFind(deviceName);
+    return it != qhSafeDeviceFiles.constEnd() && it->contains(fileName);
+}
 
-    qpdProgress = new QProgressDialog(NULL, Qt::Dialog);
-    qpdProgress->setWindowTitle(QLatin1String("Submitting crash logs..."));
-    qpdProgress->setLabelText(QLatin1String("Preparing crash logs..."));
-    qpdProgress->setWindowModality(Qt::ApplicationModal);
-    qpdProgress->resize(400, 100);
-    qpdProgress->show();
+// Replace the list of safe files for device 'deviceName'.
+void LogHandler::setSafeCrashLogs(const QString &deviceName, const QStringList &fileNames) {
+    qhSafeDeviceListings.insert(deviceName, fileNames);
+    qhSafeDeviceFiles.insert(deviceName, QSet<QString>::fromList(fileNames));
+}
 
-    QObject::connect(qpdProgress, SIGNAL(canceled()), this, SLOT(logSubmitCancelled()));
-    qpdProgress->setAutoReset(false);
-    qpdProgress->setMaximum(qlSubmitList.count()-1);
+// Get the handle of 'log', handing out a new one if it has none yet.
+int LogHandler::handleForCrashLog(const DeviceLog &log) {
+    QHash<DeviceLog, int>::const_iterator it = qhLogHandles.constFind(log);
+    if (it != qhLogHandles.constEnd())
+        return it.value();
 
-    sState = LogHandler::Submitting;
-    submitNextLog();
+    int handle = iNextHandle++;
+    qhLogHandles.insert(log, handle);
+    qhHandleLogs.insert(handle, log);
+    return handle;
+}
 
-    qelLoop = new QEventLoop(this);
-    qelLoop->exec(QEventLoop::DialogExec);
+// Get the log identified by 'handle'. Unknown handles give an empty log, which
+// never passes isSafeCrashLog(). Neither do logs that have gone away since their
+// handle was handed out.
+DeviceLog LogHandler::crashLogForHandle(int handle) const {
+    return qhHandleLogs.value(handle);
+}
 
-    delete qpdProgress;
-    delete qelLoop;
-    qpdProgress = NULL;
-    qelLoop = NULL;
+// Scan for crash logs on a worker thread. Once done, the crashLogsAvailable()
+// signal is emitted with a map of device names to their crash logs, and the
+// lists of safe devices and files are updated, as if availableCrashReporterDevices()
+// and crashFilesForDevice() had been called.
+//
+// Callable from JavaScript.
+void LogHandler::requestCrashLogs() {
+    CrashLogScanRequest request;
+    request.crashLogDirs = qslCrashLogDirs;
+    request.applications = qslApplications;
+    request.stamps = false;
+    request.hashes = false;
+    request.signatures = false;
+    request.catalog = NULL;
+    request.cachedEntries = false;
 
-    // OK, we've submitted our logs to the server. Let's clean up the logs that
-    // were successfully sent.
-    removeSubmittedLogs();
+    QFutureWatcher<CrashLogScan> *watcher = new QFutureWatcher<CrashLogScan>(this);
+    QObject::connect(watcher, SIGNAL(finished()), this, SLOT(crashLogsScanned()));
+    watcher->setFuture(QtConcurrent::run(&LogHandler::scanCrashLogs, &clmManifest, request));
 }
 
+// Called when a scan started by requestCrashLogs() has finished.
+void LogHandler::crashLogsScanned() {
+    QFutureWatcher<CrashLogScan> *watcher = static_cast<QFutureWatcher<CrashLogScan> *>(sender());
+    CrashLogScan scan = watcher->result();
+    watcher->deleteLater();
 
-// This is called when the upload of a crash log finished, to initate the next
-// upload.
-void LogHandler::submitNextLog() {
-    DeviceLog log = qlSubmitList.at(iCurrentLog);
-    qpdProgress->setLabelText(QString::fromLatin1("Submitting '%1 from device '%2'").arg(log.second, log.first));
-    qpdProgress->setValue(iCurrentLog);
-    QByteArray contents = contentsOfCrashFile(log.first, log.second);
-    QNetworkRequest req(QUrl(QLatin1String("https://mumble-ios.appspot.com/crashreporter/send")));
-    req.setHeader(QNetworkRequest::ContentTypeHeader, QVariant(QLatin1String("application/octet-stream")));
-    QNetworkReply *reply = qnamAccessManager->post(req, contents);
-    QObject::connect(reply, SIGNAL(finished()), this, SLOT(uploadFinished()));
+    applyCrashLogScan(scan);
+
+    QVariantMap crashLogs;
+    foreach (QString device, scan.devices)
+        crashLogs.insert(device, scan.files.value(device));
+    emit crashLogsAvailable(crashLogs);
 }
 
-// This is called whenever an upload is finished. In here, we check if we've
-// uploaded all available crash logs, and if that's the case we check whether
-// we've successfully uploaded all our crash logs. If we haven't successfully
-// uploaded all of our logs, we display a warning telling the user which logs
-// were not uploaded and along with a notice that they should try submitting
-// them again sometime in the near future.
-void LogHandler::uploadFinished() {
-    if (sState != LogHandler::Submitting)
-        return;
+// Gather everything the page needs to show its table of crash logs at once, on a
+// worker thread. Once done, the crashLogSnapshotAvailable() signal is emitted with a
+// map of device names to their crash logs. Each crash log is a map holding its 'file'
+// name, 'size', modification time ('mtime') and, if it could be parsed, the app
+// 'version', 'osVersion', 'exceptionType' and crash 'date' from its header.
+//
+// The header fields come from the catalog, and nothing is parsed to get them: logs
+// that are new or have changed since the catalog was last updated are listed without
+// them, and the catalog is brought up to date in the background. crashLogCatalogUpdated()
+// is emitted once it is, after which another snapshot has them. The devices and crash
+// logs become safe, as with requestCrashLogs().
+//
+// Callable from JavaScript.
+void LogHandler::requestCrashLogSnapshot() {
+    CrashLogScanRequest request;
+    request.crashLogDirs = qslCrashLogDirs;
+    request.applications = qslApplications;
+    request.stamps = true;
+    request.hashes = false;
+    request.signatures = false;
+    request.catalog = &clcCatalog;
+    request.cachedEntries = true;
 
-    QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
-    if (reply->error() == QNetworkReply::NoError) {
-        qlSubmittedLogs.append(qlSubmitList.at(iCurrentLog));
+    QFutureWatcher<CrashLogScan> *watcher = new QFutureWatcher<CrashLogScan>(this);
+    QObject::connect(watcher, SIGNAL(finished()), this, SLOT(crashLogSnapshotScanned()));
+    watcher->setFuture(QtConcurrent::run(&LogHandler::scanCrashLogs, &clmManifest, request));
+}
+
+// Called when a scan started by requestCrashLogSnapshot() has finished.
+void LogHandler::crashLogSnapshotScanned() {
+    QFutureWatcher<CrashLogScan> *watcher = static_cast<QFutureWatcher<CrashLogScan> *>(sender());
+    CrashLogScan scan = watcher->result();
+    watcher->deleteLater();
+
+    applyCrashLogScan(scan);
+
+    QVariantMap snapshot;
+    bool stale = false;
+    foreach (QString device, scan.devices) {
+        const QHash<QString, CrashLogStamp> stamps = scan.stamps.value(device);
+        QVariantList logs;
+        foreach (QString file, scan.files.value(device)) {
+            CrashLogStamp stamp = stamps.value(file);
+            QVariantMap log;
+            log.insert(QLatin1String("file"), file);
+            log.insert(QLatin1String("size"), stamp.first);
+            log.insert(QLatin1String("mtime"), QDateTime::fromTime_t(stamp.second));
+
+            QHash<DeviceLog, CatalogEntry>::const_iterator it = scan.entries.constFind(DeviceLog(device, file));
+            if (it != scan.entries.constEnd()) {
+                log.insert(QLatin1String("version"), it->version);
+                log.insert(QLatin1String("osVersion"), it->osVersion);
+                log.insert(QLatin1String("exceptionType"), it->exceptionType);
+                log.insert(QLatin1String("date"), QDateTime::fromTime_t(it->date));
+            } else {
+                stale = true;
+            }
+            logs << QVariant(log);
+        }
+        snapshot.insert(device, logs);
     }
 
-    ++iCurrentLog;
-    if (iCurrentLog < qlSubmitList.count()) {
-        submitNextLog();
-    } else {
-        sState = LogHandler::Done;
-        qpdProgress->setLabelText(QLatin1String("Done submitting crash logs"));
-        qpdProgress->setCancelButtonText(QLatin1String("OK"));
+    if (stale)
+        updateSearchIndex();
+    emit crashLogSnapshotAvailable(snapshot);
+}
+
+// Read the contents of a crash file for a particular device on a worker thread.
+// Once done, the crashFileContentsAvailable() signal is emitted with the contents
+// as a properly-encoded string. The contents are empty if the file is not one of
+// the safe files, or could not be read.
+//
+// Callable from JavaScript.
+void LogHandler::requestContentsOfCrashFile(const QString &deviceName, const QString &fileName) {
+    // Are we accessing a safe file?
+    if (qslCrashLogDirs.isEmpty() || ! isSafeCrashLog(deviceName, fileName)) {
+        emit crashFileContentsAvailable(deviceName, fileName, QString());
+        return;
     }
+
+    DeviceLog log(deviceName, fileName);
+    QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+    qhReading.insert(watcher, log);
+    QObject::connect(watcher, SIGNAL(finished()), this, SLOT(crashFileRead()));
+    watcher->setFuture(QtConcurrent::run(&LogHandler::readCrashFileAsString, crashLogPath(log)));
 }
 
-// This is the callback for the 'Cancel' button. The cancel button
-// is re-labeled to 'OK' when all crash logs have been successfully
-// uploaded, so we
-void LogHandler::logSubmitCancelled() {
-    QList<DeviceLog> failedSubmits;
+// Like requestContentsOfCrashFile(), for the crash file identified by 'handle', as
+// handed out by crashFilePageForDevice().
+//
+// Callable from JavaScript.
+void LogHandler::requestContentsOfCrashHandle(int handle) {
+    DeviceLog log = crashLogForHandle(handle);
+    requestContentsOfCrashFile(log.first, log.second);
+}
 
-    // We were cancelled while we were uploading. Set our state to
-    // done, so any future uploadFinished() signals know that they
-    // should stop the submit process.
-    if (sState == LogHandler::Submitting) {
-        sState = LogHandler::Done;
-    // We were OK'd away.
-    } else {
-        // Compile a list of non-successful submits that we can use
-        // to show the user later on.
-        foreach (DeviceLog log, qlSubmitList) {
-            if (! qlSubmittedLogs.contains(log))
-                failedSubmits << log;
-        }
-    }
+// Called when a read started by requestContentsOfCrashFile() has finished.
+void LogHandler::crashFileRead() {
+    QFutureWatcher<QString> *watcher = static_cast<QFutureWatcher<QString> *>(sender());
+    DeviceLog log = qhReading.take(watcher);
+    QString contents = watcher->result();
+    watcher->deleteLater();
 
-    qelLoop->quit();
+    emit crashFileContentsAvailable(log.first, log.second, contents);
+}
 
-    // Did any of our submits fail? If so, show
-    // a dialog explaining the user what went wrong.
-    if (failedSubmits.count() > 0) {
-        QMessageBox *qmb = new QMessageBox(NULL);
-        qmb->setIcon(QMessageBox::Warning);
-        qmb->setWindowTitle(QString("Warning"));
-        qmb->setText(QString("An error occured while submitting some of your crash logs.\n"
-                             "The crash logs that were not sent to the server are still kept on your computer.\n"
-                             "Please try again at a later time.\n"
-                             "\n"
-                             "If the problem persists, please file a bug on the Mumble for iOS Bug Tracker.\n"));
-        qmb->exec();
-        delete qmb;
+// Parse the header, crashed thread backtrace and binary images of a crash file for
+// a particular device on a worker thread. Once done, the crashFileSummaryAvailable()
+// signal is emitted with the summary; see CrashLogSummary::toVariantMap() for its
+// layout. The summary is empty if the file is not one of the safe files, or could
+// not be read.
+//
+// Callable from JavaScript.
+void LogHandler::requestSummaryOfCrashFile(const QString &deviceName, const QString &fileName) {
+    // Are we accessing a safe file?
+    if (qslCrashLogDirs.isEmpty() || ! isSafeCrashLog(deviceName, fileName)) {
+        emit crashFileSummaryAvailable(deviceName, fileName, QVariantMap());
+        return;
     }
+
+    DeviceLog log(deviceName, fileName);
+    QFutureWatcher<QVariantMap> *watcher = new QFutureWatcher<QVariantMap>(this);
+    qhSummarizing.insert(watcher, log);
+    QObject::connect(watcher, SIGNAL(finished()), this, SLOT(crashFileSummarized()));
+    watcher->setFuture(QtConcurrent::run(&LogHandler::summarizeCrashFile, crashLogPath(log)));
 }
 
-// Returns the current state of our operation. See
-// LogHandler::State (enum).
+// Like requestSummaryOfCrashFile(), for the crash file identified by 'handle', as
+// handed out by crashFilePageForDevice().
 //
 // Callable from JavaScript.
-LogHandler::State LogHandler::currentState() const {
-    return sState;
+void LogHandler::requestSummaryOfCrashHandle(int handle) {
+    DeviceLog log = crashLogForHandle(handle);
+    requestSummaryOfCrashFile(log.first, log.second);
 }
 
-// Reset us to the Ready state.
+// Called when a parse started by requestSummaryOfCrashFile() has finished.
+void LogHandler::crashFileSummarized() {
+    QFutureWatcher<QVariantMap> *watcher = static_cast<QFutureWatcher<QVariantMap> *>(sender());
+    DeviceLog log = qhSummarizing.take(watcher);
+    QVariantMap summary = watcher->result();
+    watcher->deleteLater();
+
+    emit crashFileSummaryAvailable(log.first, log.second, summary);
+}
+
+// Parse (and symbolicate, where we can) the crash log at 'path'. This
+// may run on a worker thread.
+QVariantMap LogHandler::summarizeCrashFile(const QString &path) {
+    CrashLogSummary summary;
+    if (! CrashLogParser::parseFile(path, summary))
+        return QVariantMap();
+    Symbolicator::symbolicate(summary);
+    return summary.toVariantMap();
+}
+
+// Search the crash logs in both the crash log directory and the submitted logs
+// directory for 'query', on a worker thread. A log matches if it contains all
+// words of the query. Once done, the searchResultsAvailable() signal is emitted
+// with at most 'limit' results, most recent first. Each result is a map holding
+// the 'device' and 'file' names of a log, and whether it has been 'submitted'.
 //
 // Callable from JavaScript.
-void LogHandler::resetState() {
-    sState = LogHandler::Ready;
+void LogHandler::requestSearch(const QString &query, int limit) {
+    QFutureWatcher<QStringList> *watcher = new QFutureWatcher<QStringList>(this);
+    qhSearching.insert(watcher, query);
+    QObject::connect(watcher, SIGNAL(finished()), this, SLOT(searchFinished()));
+    watcher->setFuture(QtConcurrent::run(&csiSearch, &CrashLogSearchIndex::search, query, limit));
+}
+
+// Called when a search started by requestSearch() has finished.
+void LogHandler::searchFinished() {
+    QFutureWatcher<QStringList> *watcher = static_cast<QFutureWatcher<QStringList> *>(sender());
+    QString query = qhSearching.take(watcher);
+    QStringList paths = watcher->result();
+    watcher->deleteLater();
+
+    QVariantList results;
+    foreach (QString path, paths) {
+        QFileInfo fi(path);
+        QVariantMap result;
+        result.insert(QLatin1String("device"), fi.dir().dirName());
+        result.insert(QLatin1String("file"), fi.fileName());
+        result.insert(QLatin1String("submitted"), ! qsSubmittedCrashLogDir.isEmpty() && path.startsWith(qsSubmittedCrashLogDir));
+        results << QVariant(result);
+    }
+    emit searchResultsAvailable(query, results);
 }
 
-// Remove all successfully submitted crash logs.
+// Query the metadata catalog of the crash log directory on a worker thread.
+// 'query' may hold the following keys, all of them optional:
 //
-// This method does not actually *remove* them from the system,
-// but merely copies them into our own directory in %APPDATA%
-// or ~/Library/Application Data/ depending on the platform.
-void LogHandler::removeSubmittedLogs() const {
-    if (qsCrashLogDir.isEmpty()) {
-        qWarning("LogHandler: Empty crash log dir. Not removing logs.");
-        return;
+//   device, version, osVersion, exceptionType: only match logs with exactly
+//     this value.
+//   since, until: only match logs that crashed in this range. Either a date
+//     or a number of seconds since the epoch.
+//   newestFirst: sort by crash date, newest first (default) or oldest first.
+//   offset, limit: the page of results to return. At most 50 results are
+//     returned by default.
+//
+// Once done, the crashLogQueryResults() signal is emitted with a map holding
+// the 'total' number of matching logs, the 'offset' of the page, and the
+// 'results' themselves. Each result is a map holding the 'device' and 'file'
+// names of a log and its metadata.
+//
+// Callable from JavaScript.
+void LogHandler::requestCrashLogQuery(const QVariantMap &query) {
+    CatalogQuery cq;
+    cq.device = query.value(QLatin1String("device")).toString();
+    cq.version = query.value(QLatin1String("version")).toString();
+    cq.osVersion = query.value(QLatin1String("osVersion")).toString();
+    cq.exceptionType = query.value(QLatin1String("exceptionType")).toString();
+    foreach (QString key, QStringList() << QLatin1String("since") << QLatin1String("until")) {
+        QVariant v = query.value(key);
+        uint t = 0;
+        if (v.type() == QVariant::DateTime || v.type() == QVariant::Date)
+            t = v.toDateTime().toTime_t();
+        else if (v.isValid())
+            t = static_cast<uint>(v.toDouble());
+        if (key == QLatin1String("since"))
+            cq.since = t;
+        else
+            cq.until = t;
     }
+    if (query.contains(QLatin1String("newestFirst")))
+        cq.newestFirst = query.value(QLatin1String("newestFirst")).toBool();
+    cq.offset = qMax(query.value(QLatin1String("offset")).toInt(), 0);
+    if (query.contains(QLatin1String("limit")))
+        cq.limit = query.value(QLatin1String("limit")).toInt();
 
-    if (qsSubmittedCrashLogDir.isEmpty()) {
-        qWarning("LogHandler: Empty submit dir. Not removing logs.");
-        return;
+    QFutureWatcher<CatalogPage> *watcher = new QFutureWatcher<CatalogPage>(this);
+    qhQuerying.insert(watcher, cq.offset);
+    QObject::connect(watcher, SIGNAL(finished()), this, SLOT(crashLogQueryFinished()));
+    watcher->setFuture(QtConcurrent::run(&clcCatalog, &CrashLogCatalog::query, cq));
+}
+
+// Called when a query started by requestCrashLogQuery() has finished. The
+// logs in the results are marked safe, so the page can go on to read them.
+void LogHandler::crashLogQueryFinished() {
+    QFutureWatcher<CatalogPage> *watcher = static_cast<QFutureWatcher<CatalogPage> *>(sender());
+    int offset = qhQuerying.take(watcher);
+    CatalogPage page = watcher->result();
+    watcher->deleteLater();
+
+    QVariantList entries;
+    foreach (const CatalogEntry &entry, page.entries) {
+        qsetSafeDeviceNames.insert(entry.device);
+        qhSafeDeviceFiles[entry.device].insert(entry.file);
+        qhLogPaths.insert(DeviceLog(entry.device, entry.file), entry.path);
+
+        QVariantMap result;
+        result.insert(QLatin1String("device"), entry.device);
+        result.insert(QLatin1String("file"), entry.file);
+        result.insert(QLatin1String("version"), entry.version);
+        result.insert(QLatin1String("osVersion"), entry.osVersion);
+        result.insert(QLatin1String("exceptionType"), entry.exceptionType);
+        result.insert(QLatin1String("date"), QDateTime::fromTime_t(entry.date));
+        result.insert(QLatin1String("size"), entry.size);
+        entries << QVariant(result);
     }
 
-    foreach (DeviceLog log, qlSubmittedLogs) {
-        QDir d(qsSubmittedCrashLogDir);
-        QByteArray contents = contentsOfCrashFile(log.first, log.second);
-        if (! d.exists(log.first)) {
-            if (! d.mkpath(log.first)) {
-                qWarning("LogHandler: Failed to mkpath '%s'. Skipping log.", qPrintable(log.first));
-                continue;
-            }
-        }
-        if (! d.cd(log.first)) {
-            qWarning("LogHandler: Could not change to device directory. Skipping log.");
-            continue;
-        }
+    QVariantMap results;
+    results.insert(QLatin1String("total"), page.total);
+    results.insert(QLatin1String("offset"), offset);
+    results.insert(QLatin1String("results"), entries);
+    emit crashLogQueryResults(results);
+}
 
-        QFile f(d.filePath(log.second));
-        if (f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-            qint64 written = f.write(contents);
-            f.close();
-            if (written != -1) {
-                if (f.exists()) {
-                    QDir crashLogDir(qsCrashLogDir);
-                    if (crashLogDir.cd(log.first)) {
-                        if (crashLogDir.remove(log.second)) {
-                            qWarning("LogHandler: %s successfully removed.", qPrintable(log.second));
-                        }
-                    } else {
-                        qWarning("LogHandler: Could not change to submit subdirectory.");
-                    }
-                } else {
-                    qWarning("LogHandler: Copied file does not exist.");
-                }
-            } else {
-                qWarning("LogHandler: Error while copying file.");
-            }
-        } else {
-            qWarning("LogHandler: Unable to open target file for copying.");
-        }
+// Read the crash log at 'path'. This may run on a worker thread.
+QByteArray LogHandler::readCrashFile(const QString &path) {
+    QFile f(path);
+    if (! f.open(QIODevice::ReadOnly))
+        return QByteArray();
+    QByteArray contents = f.readAll();
+    f.close();
+
+    return contents;
+}
+
+// Read the crash log at 'path' as a string. This may run on a worker thread.
+QString LogHandler::readCrashFileAsString(const QString &path) {
+    QByteArray qbaContents = readCrashFile(path);
+    return QString::fromUtf8(qbaContents.constData(), qbaContents.length());
+}
+
+// Returns the names of the devices in the crash log directory 'crashLogDir'. The
+// directory listing comes from 'manifest'. This may run on a worker thread.
+QStringList LogHandler::crashReporterDevices(CrashLogManifest *manifest, const QString &crashLogDir) {
+    if (crashLogDir.isEmpty())
+        return QStringList();
+
+    // Don't include .symbolicated devices.
+    QStringList devices;
+    foreach (QString dev, manifest->subdirectories(crashLogDir)) {
+        if (dev.endsWith(QLatin1String(".symbolicated")))
+            continue;
+        devices << dev;
     }
+    return devices;
+}
+
+// Returns the file names of all crash logs (.crash logs and .ips reports) for the iOS applications
+// in 'appNames' in the device directory 'deviceDir'. All apps are matched in a single pass over the
+// directory listing, which comes from 'manifest'. This may run on a worker thread.
+QStringList LogHandler::crashLogFilesForApplications(CrashLogManifest *manifest, const QString &deviceDir, const QStringList &appNames) {
+    if (deviceDir.isEmpty() || appNames.isEmpty())
+		return QStringList();
+
+    QStringList alternatives;
+    foreach (QString appName, appNames)
+        alternatives << QRegExp::escape(appName);
+    QRegExp filter(QString::fromLatin1("(%1).*\\.(crash|ips)").arg(alternatives.join(QLatin1String("|"))), Qt::CaseInsensitive);
+
+    QStringList fileNames;
+    foreach (QString file, manifest->files(deviceDir)) {
+        if (filter.exactMatch(file))
+            fileNames << file;
+    }
+    return fileNames;
+}
+
+// List the devices and crash logs of a single crash log directory, as described by
+// 'task'. This runs on a worker thread; see listCrashLogs().
+CrashLogScan LogHandler::listCrashLogDirectory(const CrashLogDirectoryTask &task) {
+    CrashLogScan scan;
+    QDir d(task.crashLogDir);
+    foreach (QString device, crashReporterDevices(task.manifest, task.crashLogDir)) {
+        if (! task.deviceName.isEmpty() && device != task.deviceName)
+            continue;
+
+        QString deviceDir = d.filePath(device);
+        QDir dd(deviceDir);
+        QStringList files = crashLogFilesForApplications(task.manifest, deviceDir, task.applications);
+        scan.devices << device;
+        scan.deviceDirs[device] << deviceDir;
+        scan.files.insert(device, files);
+        foreach (QString file, files)
+            scan.paths.insert(DeviceLog(device, file), dd.filePath(file));
+    }
+    return scan;
+}
+
+// List the devices and crash logs for the apps in 'appNames' in all of 'crashLogDirs', or
+// only those of device 'deviceName' if it is set. The directories are listed concurrently,
+// and the results merged in order: if two directories hold a crash log with the same device
+// and file name, the first one wins. This may run on a worker thread.
+CrashLogScan LogHandler::listCrashLogs(CrashLogManifest *manifest, const QStringList &crashLogDirs, const QStringList &appNames, const QString &deviceName) {
+    QList<CrashLogDirectoryTask> tasks;
+    foreach (QString dir, crashLogDirs) {
+        if (dir.isEmpty())
+            continue;
+        CrashLogDirectoryTask task;
+        task.manifest = manifest;
+        task.crashLogDir = dir;
+        task.applications = appNames;
+        task.deviceName = deviceName;
+        tasks << task;
+    }
+
+    // blockingMapped() lends a hand from the calling thread, so this is
+    // safe to call from a thread pool thread as well.
+    CrashLogScan scan;
+    QList<CrashLogScan> parts = QtConcurrent::blockingMapped<QList<CrashLogScan> >(tasks, &LogHandler::listCrashLogDirectory);
+    foreach (const CrashLogScan &part, parts) {
+        foreach (QString device, part.devices) {
+            if (! scan.deviceDirs.contains(device))
+                scan.devices << device;
+            scan.deviceDirs[device] += part.deviceDirs.value(device);
+
+            QStringList &files = scan.files[device];
+            foreach (QString file, part.files.value(device)) {
+                DeviceLog log(device, file);
+                if (scan.paths.contains(log))
+                    continue;
+                files << file;
+                scan.paths.insert(log, part.paths.value(log));
+            }
+        }
+    }
+    return scan;
+}
+
+// Scan the crash log directories for devices and their crash logs, gathering
+// stamps and content hashes as asked for by 'request'. This runs on a worker
+// thread, and only touches the (thread-safe) manifest.
+CrashLogScan LogHandler::scanCrashLogs(CrashLogManifest *manifest, const CrashLogScanRequest &request) {
+    CrashLogScan scan = listCrashLogs(manifest, request.crashLogDirs, request.applications);
+    foreach (QString device, scan.devices) {
+        QStringList files = scan.files.value(device);
+
+        if (request.stamps && (! request.knownDevices.contains(device) || request.dirtyDevices.contains(device))) {
+            QHash<QString, CrashLogStamp> &stamps = scan.stamps[device];
+            foreach (QString file, files) {
+                QFileInfo fi(scan.paths.value(DeviceLog(device, file)));
+                stamps.insert(file, CrashLogStamp(fi.size(), fi.lastModified().toTime_t()));
+            }
+        }
+
+        if (request.hashes) {
+            foreach (QString file, files) {
+                DeviceLog log(device, file);
+                QString path = scan.paths.value(log);
+                scan.hashes.insert(log, manifest->hashForFile(path));
+                scan.sizes.insert(log, QFileInfo(path).size());
+            }
+        }
+
+        if (request.signatures) {
+            foreach (QString file, files) {
+                DeviceLog log(device, file);
+                CrashLogSummary summary;
+                if (! CrashLogParser::parseFile(scan.paths.value(log), summary))
+                    continue;
+                Symbolicator::symbolicate(summary);
+                scan.signatures.insert(log, summary.signature());
+            }
+        }
+
+        if (request.catalog) {
+            foreach (QString file, files) {
+                DeviceLog log(device, file);
+                CatalogEntry entry;
+                bool found;
+                if (request.cachedEntries) {
+                    CrashLogStamp stamp = scan.stamps.value(device).value(file);
+                    found = request.catalog->cachedEntryForFile(scan.paths.value(log), stamp.first, stamp.second, entry);
+                } else {
+                    found = request.catalog->entryForFile(scan.paths.value(log), entry);
+                }
+                if (found)
+                    scan.entries.insert(log, entry);
+            }
+        }
+    }
+
+    manifest->save();
+    return scan;
+}
+
+// Make the devices and crash logs found by a scan available to JavaScript.
+void LogHandler::applyCrashLogScan(const CrashLogScan &scan) {
+    qsetSafeDeviceNames = QSet<QString>::fromList(scan.devices);
+    qhDeviceDirs = scan.deviceDirs;
+    qhLogPaths = scan.paths;
+    qhSafeDeviceFiles.clear();
+    qhSafeDeviceListings.clear();
+    QMap<QString, QStringList>::const_iterator i;
+    for (i = scan.files.constBegin(); i != scan.files.constEnd(); ++i)
+        setSafeCrashLogs(i.key(), i.value());
+}
+
+// List all available crash logs found by 'scan'.
+//
+// Logs whose content hash is found in the submitted log index have already been
+// sent to the server. They are left out of the returned list, and collected in
+// qlDuplicateLogs instead, so they can be archived. Logs with the same contents
+// as an earlier log in the list need not be sent twice either, but they can only
+// be archived once that earlier log has made it to the server; until then, they
+// are held back in qhTwins. The content hash of every log is kept in qhLogHashes.
+QList<DeviceLog> LogHandler::allCrashLogs(const CrashLogScan &scan) {
+    QList<DeviceLog> logs;
+    QSet<QByteArray> seen;
+    qlDuplicateLogs.clear();
+    qhLogHashes.clear();
+    foreach (QString device, scan.devices) {
+        foreach (QString file, scan.files.value(device)) {
+            DeviceLog log(device, file);
+            if (retryInFlight(log))
+                continue;
+            QByteArray hash = scan.hashes.value(log);
+            qhLogHashes.insert(log, hash);
+            if (! hash.isEmpty() && sliSubmitted.contains(hash)) {
+                qlDuplicateLogs.push_back(log);
+                continue;
+            }
+            if (! hash.isEmpty() && seen.contains(hash)) {
+                qhTwins[hash] << log;
+                continue;
+            }
+            seen.insert(hash);
+            logs.push_back(log);
+        }
+    }
+    return logs;
+}
+
+// Submit all crash logs, showing a modal progress dialog until the user
+// dismisses it. This is a wrapper around startSubmittingCrashLogs(), and
+// only returns once the submit is over.
+//
+// Callable from JavaScript.
+void LogHandler::submitAllCrashLogs() {
+    // We can only submit if we're in the ready state.
+    if (sState != LogHandler::Ready)
+        return;
+
+    qpdProgress = new QProgressDialog(NULL, Qt::Dialog);
+    qpdProgress->setWindowTitle(QLatin1String("Submitting crash logs..."));
+    qpdProgress->setLabelText(QLatin1String("Looking for crash logs..."));
+    qpdProgress->setWindowModality(Qt::ApplicationModal);
+    qpdProgress->resize(400, 100);
+    qpdProgress->show();
+
+    QObject::connect(qpdProgress, SIGNAL(canceled()), this, SLOT(logSubmitCancelled()));
+    QObject::connect(this, SIGNAL(submitStatusChanged(QString)), qpdProgress, SLOT(setLabelText(QString)));
+    qpdProgress->setAutoReset(false);
+    qpdProgress->setMaximum(0);
+    qpdProgress->setValue(0);
+
+    qelLoop = new QEventLoop(this);
+    startSubmittingCrashLogs();
+    qelLoop->exec(QEventLoop::DialogExec);
+
+    delete qpdProgress;
+    delete qelLoop;
+    qpdProgress = NULL;
+    qelLoop = NULL;
+}
+
+// Start submitting all crash logs, and return right away. Returns false if
+// a submit is already in progress.
+//
+// As the submit progresses, the following signals are emitted:
+//
+//  - submitStatusChanged() with a description of what we're doing.
+//  - submitProgress() with the number of logs dealt with, and the number
+//    of request body bytes sent. The byte total is an estimate until all
+//    bodies have been prepared, since bodies may be compressed.
+//  - crashLogSubmitted() for each log, once it is dealt with.
+//  - submitFinished() once the submit is over, with 'cancelled' false, or
+//    once cancelSubmittingCrashLogs() has stopped it, with 'cancelled' true.
+//    It is emitted exactly once per submit, either way.
+//
+// Callable from JavaScript.
+bool LogHandler::startSubmittingCrashLogs() {
+    if (sState != LogHandler::Ready)
+        return false;
+
+    iNextLog = 0;
+    iFinishedLogs = 0;
+    Settings *s = Settings::get();
+    iMaxInFlight = s->maxConcurrentUploads();
+    bBatchUploads = s->batchUploads();
+    iBatchMaxLogs = s->batchMaxLogs();
+    iBatchMaxBytes = s->batchMaxBytes();
+    bRepresentatives = s->uploadRepresentatives();
+    iRepresentatives = s->representativesPerSignature();
+    ueEncoding = preferredEncoding();
+    qhPreparing.clear();
+    qhInFlight.clear();
+    qhUploadBytes.clear();
+    qlResendGroups.clear();
+    qlSubmittedLogs.clear();
+    qlSubmitList.clear();
+    qhOccurrences.clear();
+    qhSuppressed.clear();
+    qhTwins.clear();
+    iBytesDone = 0;
+    iBytesPending = 0;
+
+    sState = LogHandler::Submitting;
+    emit submitStatusChanged(QLatin1String("Looking for crash logs..."));
+
+    // Listing and hashing the crash logs can take a while, so it
+    // happens on a worker thread. See submitScanFinished().
+    CrashLogScanRequest request;
+    request.crashLogDirs = qslCrashLogDirs;
+    request.applications = qslApplications;
+    request.stamps = false;
+    request.hashes = true;
+    request.signatures = bRepresentatives;
+    request.catalog = &clcCatalog;
+    request.cachedEntries = false;
+
+    qfwSubmitScan = new QFutureWatcher<CrashLogScan>(this);
+    QObject::connect(qfwSubmitScan, SIGNAL(finished()), this, SLOT(submitScanFinished()));
+    qfwSubmitScan->setFuture(QtConcurrent::run(&LogHandler::scanCrashLogs, &clmManifest, request));
+    return true;
+}
+
+// Cancel the submit in progress. Uploads that are still in flight are
+// aborted, and their logs are queued for retry, since the server may or
+// may not have received them; crashLogSubmitted() is emitted for each of
+// them as failed. Logs that weren't sent yet are left in place, and come
+// up again with the next submit. submitFinished() is then emitted with
+// 'cancelled' set, counting every log that wasn't submitted as failed.
+//
+// Callable from JavaScript.
+void LogHandler::cancelSubmittingCrashLogs() {
+    if (sState != LogHandler::Submitting)
+        return;
+
+    // Set our state to done, so any future uploadFinished() signals
+    // know that they should stop the submit process.
+    sState = LogHandler::Done;
+    qfwSubmitScan = NULL;
+    if (qnrNegotiation)
+        qnrNegotiation->abort();
+    foreach (QFutureWatcher<UploadBody> *watcher, qhPreparing.keys()) {
+        watcher->disconnect(this);
+        QObject::connect(watcher, SIGNAL(finished()), this, SLOT(uploadBodyDiscarded()));
+    }
+    qhPreparing.clear();
+
+    // Aborting a reply finishes it right away, and uploadFinished() leaves
+    // it alone now that we're done, so its logs are collected beforehand.
+    QList<DeviceLog> aborted;
+    foreach (QList<int> indices, qhInFlight) {
+        foreach (int idx, indices)
+            aborted << qlSubmitList.at(idx);
+    }
+    foreach (QNetworkReply *reply, qhInFlight.keys())
+        reply->abort();
+    qhUploadBytes.clear();
+    foreach (DeviceLog log, aborted) {
+        rqRetry.add(log, crashLogPath(log), qhLogHashes.value(log));
+        emit crashLogSubmitted(log.first, log.second, false);
+    }
+
+    scheduleRetry();
+    emit submitStatusChanged(QLatin1String("Cancelled submitting crash logs"));
+    emit submitFinished(qlSubmittedLogs.count(), qlSubmitList.count() - qlSubmittedLogs.count(), true);
+}
+
+// Called when the scan started by startSubmittingCrashLogs() has finished.
+// Starts the actual submission, unless there is nothing to submit, in which
+// case we go straight back to the ready state.
+void LogHandler::submitScanFinished() {
+    QFutureWatcher<CrashLogScan> *watcher = static_cast<QFutureWatcher<CrashLogScan> *>(sender());
+    CrashLogScan scan = watcher->result();
+    watcher->deleteLater();
+
+    // The submit was cancelled while we were scanning.
+    if (watcher != qfwSubmitScan)
+        return;
+    qfwSubmitScan = NULL;
+
+    applyCrashLogScan(scan);
+    qlSubmitList = allCrashLogs(scan);
+    qhLogSizes = scan.sizes;
+    qhLogSignatures = scan.signatures;
+    if (! bDryRun) {
+        foreach (DeviceLog log, qlDuplicateLogs)
+            archiveLog(log, crashLogPath(log));
+    }
+    prioritizeSubmitList(scan);
+    if (bRepresentatives)
+        selectRepresentatives();
+
+    foreach (DeviceLog log, qlSubmitList)
+        emit crashLogQueued(log.first, log.second);
+
+    if (qlSubmitList.isEmpty() || bDryRun) {
+        sState = LogHandler::Ready;
+        emit submitFinished(0, 0, false);
+        return;
+    }
+
+    foreach (DeviceLog log, qlSubmitList)
+        iBytesPending += qhLogSizes.value(log);
+
+    if (Settings::get()->negotiateUploads())
+        negotiateUploads();
+    else
+        fillUploadWindow();
+}
+
+
+// Before uploading anything, send the server the content hashes of all the logs
+// we're about to submit, and let it tell us which of them it doesn't have yet.
+// This way, a popular crash that many testers hit is only uploaded once.
+//
+// The request body is a list of hex-encoded SHA-1 hashes, one per line. The
+// server replies with the hashes of the logs it wants, one per line, and
+// marks its reply with an X-Crash-Have header, so that a server without the
+// endpoint can't be mistaken for one that wants nothing.
+void LogHandler::negotiateUploads() {
+    QByteArray body;
+    foreach (DeviceLog log, qlSubmitList) {
+        QByteArray hash = qhLogHashes.value(log);
+        if (hash.isEmpty())
+            continue;
+        body.append(hash.toHex());
+        body.append('\n');
+    }
+
+    emit submitStatusChanged(QLatin1String("Checking which crash logs the server needs..."));
+
+    QNetworkRequest req(uploadUrl(QLatin1String("/crashreporter/have")));
+    req.setHeader(QNetworkRequest::ContentTypeHeader, QVariant(QLatin1String("text/plain")));
+    qnrNegotiation = qnamAccessManager->post(req, body);
+    QObject::connect(qnrNegotiation, SIGNAL(finished()), this, SLOT(negotiationFinished()));
+}
+
+// Parse the reply to negotiateUploads() into the set of hashes the server
+// wants. Returns false unless the reply is a well-formed negotiation reply:
+// marked with the X-Crash-Have header, and holding nothing but hex-encoded
+// SHA-1 hashes.
+static bool parseNegotiationReply(QNetworkReply *reply, QSet<QByteArray> &wanted) {
+    static const QRegExp hashLine(QLatin1String("[0-9a-f]{40}"));
+
+    if (reply->error() != QNetworkReply::NoError)
+        return false;
+    if (reply->rawHeader("X-Crash-Have") != "1")
+        return false;
+
+    foreach (QByteArray line, reply->readAll().split('\n')) {
+        line = line.trimmed().toLower();
+        if (line.isEmpty())
+            continue;
+        if (! hashLine.exactMatch(QString::fromLatin1(line)))
+            return false;
+        wanted.insert(QByteArray::fromHex(line));
+    }
+    return true;
+}
+
+// Called when the server has replied to negotiateUploads(). Logs that the
+// server already has are treated as submitted, and the rest are uploaded.
+// If the server does not support negotiation, sends back anything but a
+// list of hashes, or the request fails for any other reason, we simply
+// upload everything.
+void LogHandler::negotiationFinished() {
+    QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
+    reply->deleteLater();
+    qnrNegotiation = NULL;
+
+    if (sState != LogHandler::Submitting)
+        return;
+
+    QSet<QByteArray> wanted;
+    if (parseNegotiationReply(reply, wanted)) {
+        QList<DeviceLog> want;
+        foreach (DeviceLog log, qlSubmitList) {
+            QByteArray hash = qhLogHashes.value(log);
+            if (hash.isEmpty() || wanted.contains(hash)) {
+                want << log;
+            } else {
+                qlDuplicateLogs << log;
+                sliSubmitted.insert(hash);
+                iBytesPending -= qhLogSizes.value(log);
+                archiveLog(log, crashLogPath(log));
+                emit crashLogSubmitted(log.first, log.second, true);
+                releaseTwinLogs(log);
+                releaseSuppressedLogs(log);
+            }
+        }
+
+        qWarning("LogHandler: Server already has %i of %i crash logs.", qlSubmitList.count() - want.count(), qlSubmitList.count());
+        qlSubmitList = want;
+    } else if (reply->error() != QNetworkReply::NoError) {
+        qWarning("LogHandler: Upload negotiation failed (%s). Submitting all crash logs.", qPrintable(reply->errorString()));
+    } else {
+        qWarning("LogHandler: Server does not support upload negotiation. Submitting all crash logs.");
+    }
+
+    if (qlSubmitList.isEmpty())
+        finishSubmission();
+    else
+        fillUploadWindow();
+}
+
+// Called once all logs have been dealt with.
+void LogHandler::finishSubmission() {
+    sState = LogHandler::Done;
+    scheduleRetry();
+    updateSearchIndex();
+    emit submitStatusChanged(QLatin1String("Done submitting crash logs"));
+    emit submitFinished(qlSubmittedLogs.count(), qlSubmitList.count() - qlSubmittedLogs.count(), false);
+}
+
+// Compare two app versions, such as "1.2.3", part by part. Numeric parts
+// are compared as numbers, and anything else as text. Returns a negative
+// number, zero or a positive number if 'a' is older than, the same as or
+// newer than 'b'.
+static int compareVersions(const QString &a, const QString &b) {
+    static const QRegExp separators(QLatin1String("[.\\-\\s]+"));
+    QStringList pa = a.split(separators, QString::SkipEmptyParts);
+    QStringList pb = b.split(separators, QString::SkipEmptyParts);
+    for (int i = 0; i < qMin(pa.count(), pb.count()); i++) {
+        bool oka, okb;
+        qulonglong na = pa.at(i).toULongLong(&oka);
+        qulonglong nb = pb.at(i).toULongLong(&okb);
+        if (oka && okb) {
+            if (na != nb)
+                return na < nb ? -1 : 1;
+        } else {
+            int c = QString::compare(pa.at(i), pb.at(i));
+            if (c != 0)
+                return c;
+        }
+    }
+    return pa.count() - pb.count();
+}
+
+// Orders crash logs for upload: logs from the latest app version first,
+// and within a version, the most recent crashes first. Logs that aren't
+// in the catalog go last, in their original order.
+struct UploadPriority {
+    const QHash<DeviceLog, CatalogEntry> &entries;
+
+    UploadPriority(const QHash<DeviceLog, CatalogEntry> &e) : entries(e) {
+    }
+
+    bool operator()(const DeviceLog &a, const DeviceLog &b) const {
+        QHash<DeviceLog, CatalogEntry>::const_iterator ea = entries.constFind(a);
+        QHash<DeviceLog, CatalogEntry>::const_iterator eb = entries.constFind(b);
+        if (eb == entries.constEnd())
+            return ea != entries.constEnd();
+        if (ea == entries.constEnd())
+            return false;
+        int c = compareVersions(ea.value().version, eb.value().version);
+        if (c != 0)
+            return c > 0;
+        return ea.value().date > eb.value().date;
+    }
+};
+
+// Sort qlSubmitList so the crashes that matter most to developers, those in
+// the latest release and those that happened most recently, are uploaded
+// first. If the submit is cut short, by a flaky connection or by the user,
+// these have the best chance of having made it. This also decides which
+// logs of a group are kept by selectRepresentatives().
+void LogHandler::prioritizeSubmitList(const CrashLogScan &scan) {
+    qStableSort(qlSubmitList.begin(), qlSubmitList.end(), UploadPriority(scan.entries));
+}
+
+// Testers often hit the same crash over and over. When only representatives
+// are to be uploaded, the logs in qlSubmitList are grouped by their crash
+// signature, and only the first iRepresentatives logs of each group are kept.
+// Each of those is sent along with the number of logs in its group. The rest
+// are held back in qhSuppressed, and archived as soon as one representative
+// of their group has been submitted. Logs without a signature are always
+// uploaded.
+void LogHandler::selectRepresentatives() {
+    QHash<QByteArray, int> bucketSizes;
+    foreach (DeviceLog log, qlSubmitList) {
+        QByteArray signature = qhLogSignatures.value(log);
+        if (! signature.isEmpty())
+            bucketSizes[signature]++;
+    }
+
+    QHash<QByteArray, int> taken;
+    QList<DeviceLog> representatives;
+    foreach (DeviceLog log, qlSubmitList) {
+        QByteArray signature = qhLogSignatures.value(log);
+        if (signature.isEmpty()) {
+            representatives << log;
+        } else if (taken.value(signature) < iRepresentatives) {
+            taken[signature]++;
+            representatives << log;
+            qhOccurrences.insert(log, bucketSizes.value(signature));
+        } else {
+            qhSuppressed[signature] << log;
+        }
+    }
+
+    qWarning("LogHandler: Uploading %i representatives of %i crash logs.", representatives.count(), qlSubmitList.count());
+    qlSubmitList = representatives;
+}
+
+// Returns the combined size of the crash logs at 'indices' in qlSubmitList.
+qint64 LogHandler::uploadGroupSize(const QList<int> &indices) const {
+    qint64 size = 0;
+    foreach (int idx, indices)
+        size += qhLogSizes.value(qlSubmitList.at(idx));
+    return size;
+}
+
+// Emit the submitProgress() signal. Bytes are counted from the request
+// bodies of finished and in-flight uploads. Logs that haven't been posted
+// yet are counted by their size on disk.
+void LogHandler::emitSubmitProgress() {
+    qint64 sent = iBytesDone;
+    qint64 total = iBytesDone + iBytesPending;
+    QHash<QNetworkReply *, QPair<qint64, qint64> >::const_iterator i;
+    for (i = qhUploadBytes.constBegin(); i != qhUploadBytes.constEnd(); ++i) {
+        sent += i.value().first;
+        total += i.value().second;
+    }
+    emit submitProgress(iFinishedLogs, qlSubmitList.count(), sent, total);
+}
+
+// Returns the absolute path of a crash log in the iTunes crash report directory.
+QString LogHandler::crashLogPath(const DeviceLog &log) const {
+    QString path = qhLogPaths.value(log);
+    if (path.isEmpty()) {
+        QStringList dirs = qhDeviceDirs.value(log.first);
+        if (! dirs.isEmpty())
+            path = QDir(dirs.first()).filePath(log.second);
+    }
+    return path;
+}
+
+// Returns the URL of 'path' on the crash reporter server.
+QUrl LogHandler::uploadUrl(const QString &path) const {
+    QString server = Settings::get()->uploadServer();
+    while (server.endsWith(QLatin1Char('/')))
+        server.chop(1);
+    return QUrl(server + path);
+}
+
+// Take the indices of the next group of logs to post off qlSubmitList.
+//
+// In batch mode, logs are packed into the group until either the count cap
+// or the byte cap is reached. A single log larger than the byte cap is sent
+// in a batch of its own. Outside of batch mode, each group holds one log.
+QList<int> LogHandler::takeNextUploadGroup() {
+    QList<int> group;
+    qint64 bytes = 0;
+
+    while (iNextLog < qlSubmitList.count()) {
+        if (! bBatchUploads) {
+            group << iNextLog++;
+            break;
+        }
+
+        qint64 size = qhLogSizes.value(qlSubmitList.at(iNextLog));
+        if (! group.isEmpty() && (group.count() >= iBatchMaxLogs || bytes + size > iBatchMaxBytes))
+            break;
+
+        group << iNextLog++;
+        bytes += size;
+    }
+
+    return group;
+}
+
+// Start uploads until we have iMaxInFlight requests in flight, or until
+// there are no more logs left to submit. This is called once to open the
+// window, and again whenever an upload finishes to refill it. Requests whose
+// bodies are still being prepared count towards the window.
+void LogHandler::fillUploadWindow() {
+    while (qhInFlight.count() + qhPreparing.count() < iMaxInFlight) {
+        if (! qlResendGroups.isEmpty())
+            startUpload(qlResendGroups.takeFirst());
+        else if (iNextLog < qlSubmitList.count())
+            startUpload(takeNextUploadGroup());
+        else
+            break;
+    }
+
+    emit submitStatusChanged(QString::fromLatin1("Submitting crash logs (%1 of %2 done)...").arg(iFinishedLogs).arg(qlSubmitList.count()));
+    emitSubmitProgress();
+}
+
+// Start uploading the logs at 'indices' in qlSubmitList. Reading (and
+// compressing) the logs happens on a worker thread. The request itself is
+// posted from uploadBodyReady() once the body is ready.
+void LogHandler::startUpload(const QList<int> &indices) {
+    QList<UploadEntry> entries;
+    foreach (int idx, indices) {
+        UploadEntry entry;
+        entry.log = qlSubmitList.at(idx);
+        entry.path = crashLogPath(entry.log);
+        entries << entry;
+    }
+
+    QFutureWatcher<UploadBody> *watcher = new QFutureWatcher<UploadBody>(this);
+    qhPreparing.insert(watcher, indices);
+    QObject::connect(watcher, SIGNAL(finished()), this, SLOT(uploadBodyReady()));
+    watcher->setFuture(QtConcurrent::run(&LogHandler::prepareUploadBody, entries, bBatchUploads, ueEncoding, qbaDictionary));
+}
+
+// Size of the chunks in which crash logs are read when preparing a body.
+static const qint64 ReadChunkSize = 64 * 1024;
+
+// Append 'len' bytes from 'data' to a request body that is being written
+// to 'out', passing it through 'deflater' first if we're compressing.
+static bool appendToBody(QIODevice *out, DeflateWriter *deflater, const char *data, qint64 len) {
+    if (deflater)
+        return deflater->write(data, len);
+    return out->write(data, len) == len;
+}
+
+// Append the contents of the file 'src' (of size 'size') to a request body,
+// one chunk at a time.
+static bool appendFileToBody(QIODevice *out, DeflateWriter *deflater, QFile *src, qint64 size) {
+    char buffer[ReadChunkSize];
+    qint64 remaining = size;
+    while (remaining > 0) {
+        qint64 len = src->read(buffer, qMin(remaining, ReadChunkSize));
+        if (len <= 0)
+            return false;
+        if (! appendToBody(out, deflater, buffer, len))
+            return false;
+        remaining -= len;
+    }
+    return true;
+}
+
+// Build the request body for 'entries'. This runs on a worker thread.
+//
+// Outside of batch mode, the body is simply the contents of the single log in
+// 'entries'. In batch mode, the body is a length-prefixed container, serialized
+// with QDataStream in little endian byte order:
+//
+//   "MCRB"                      (4 bytes, magic)
+//   quint32 version             (currently 1)
+//   quint32 count
+//   count times:
+//     quint32 len, device name  (UTF-8)
+//     quint32 len, file name    (UTF-8)
+//     quint32 len, log contents
+//
+// The server replies with one line per entry, in the order the entries were
+// sent. A line reading 'OK' means that the log was stored. See uploadFinished().
+//
+// Unless 'encoding' is PlainEncoding, the resulting body is deflated as a whole,
+// against 'dictionary' for DictionaryEncoding.
+//
+// Bodies are never held in memory as a whole. An uncompressed single log is
+// posted straight from its file. Everything else is streamed, a chunk at a
+// time, into a temporary file, which is posted and then removed once the reply
+// has finished. Returns a body with an empty path on failure.
+UploadBody LogHandler::prepareUploadBody(const QList<UploadEntry> &entries, bool batch, UploadEncoding encoding, const QByteArray &dictionary) {
+    UploadBody body;
+    body.batch = batch;
+    body.encoding = encoding;
+    body.temporary = false;
+
+    if (! batch && encoding == PlainEncoding) {
+        if (QFile::exists(entries.first().path))
+            body.path = entries.first().path;
+        return body;
+    }
+
+    QTemporaryFile tmp(QDir::temp().filePath(QLatin1String("MumbleCrashUpload-XXXXXX")));
+    tmp.setAutoRemove(false);
+    if (! tmp.open()) {
+        qWarning("LogHandler: Unable to create temporary file for upload.");
+        return body;
+    }
+
+    DeflateWriter *deflater = NULL;
+    if (encoding != PlainEncoding)
+        deflater = new DeflateWriter(&tmp, encoding == DictionaryEncoding ? dictionary : QByteArray());
+
+    bool ok = true;
+    if (batch) {
+        QByteArray header;
+        QDataStream qds(&header, QIODevice::WriteOnly);
+        qds.setVersion(QDataStream::Qt_4_6);
+        qds.setByteOrder(QDataStream::LittleEndian);
+        qds.writeRawData("MCRB", 4);
+        qds << static_cast<quint32>(1);
+        qds << static_cast<quint32>(entries.count());
+        ok = appendToBody(&tmp, deflater, header.constData(), header.length());
+
+        foreach (UploadEntry entry, entries) {
+            if (! ok)
+                break;
+
+            QFile src(entry.path);
+            if (! src.open(QIODevice::ReadOnly)) {
+                ok = false;
+                break;
+            }
+
+            QByteArray device = entry.log.first.toUtf8();
+            QByteArray file = entry.log.second.toUtf8();
+            qint64 size = src.size();
+
+            QByteArray prefix;
+            QDataStream pds(&prefix, QIODevice::WriteOnly);
+            pds.setVersion(QDataStream::Qt_4_6);
+            pds.setByteOrder(QDataStream::LittleEndian);
+            pds << static_cast<quint32>(device.length());
+            pds.writeRawData(device.constData(), device.length());
+            pds << static_cast<quint32>(file.length());
+            pds.writeRawData(file.constData(), file.length());
+            pds << static_cast<quint32>(size);
+
+            ok = appendToBody(&tmp, deflater, prefix.constData(), prefix.length())
+                 && appendFileToBody(&tmp, deflater, &src, size);
+            src.close();
+        }
+    } else {
+        QFile src(entries.first().path);
+        ok = src.open(QIODevice::ReadOnly) && appendFileToBody(&tmp, deflater, &src, src.size());
+    }
+
+    if (ok && deflater)
+        ok = deflater->finish();
+    delete deflater;
+
+    QString path = tmp.fileName();
+    tmp.close();
+    if (! ok) {
+        qWarning("LogHandler: Unable to prepare upload body.");
+        QFile::remove(path);
+        return body;
+    }
+
+    // A single log that didn't shrink is better off sent as-is.
+    if (! batch && QFileInfo(path).size() >= QFileInfo(entries.first().path).size()) {
+        QFile::remove(path);
+        body.encoding = PlainEncoding;
+        body.path = entries.first().path;
+        return body;
+    }
+
+    body.path = path;
+    body.temporary = true;
+    return body;
+}
+
+// Called when a request body has been prepared on the worker thread. Posts
+// the request to the server.
+void LogHandler::uploadBodyReady() {
+    QFutureWatcher<UploadBody> *watcher = static_cast<QFutureWatcher<UploadBody> *>(sender());
+    QList<int> indices = qhPreparing.take(watcher);
+    UploadBody body = watcher->result();
+    watcher->deleteLater();
+
+    if (sState != LogHandler::Submitting) {
+        discardUploadBody(body);
+        return;
+    }
+
+    iBytesPending -= uploadGroupSize(indices);
+    QList<DeviceLog> logs;
+    foreach (int idx, indices)
+        logs << qlSubmitList.at(idx);
+    QNetworkReply *reply = postUploadBody(body, logs);
+    if (! reply) {
+        uploadGroupFinished(indices, QSet<int>());
+        return;
+    }
+    qhInFlight.insert(reply, indices);
+    qhUploadBytes.insert(reply, QPair<qint64, qint64>(0, QFileInfo(body.path).size()));
+    QObject::connect(reply, SIGNAL(uploadProgress(qint64, qint64)), this, SLOT(uploadProgressed(qint64, qint64)));
+    QObject::connect(reply, SIGNAL(finished()), this, SLOT(uploadFinished()));
+}
+
+// Called as the request body of an upload is being sent.
+void LogHandler::uploadProgressed(qint64 bytesSent, qint64 bytesTotal) {
+    Q_UNUSED(bytesTotal);
+
+    QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
+    if (! qhUploadBytes.contains(reply))
+        return;
+
+    qhUploadBytes[reply].first = bytesSent;
+    emitSubmitProgress();
+}
+
+// Called for prepared bodies that belong to a cancelled submit.
+void LogHandler::uploadBodyDiscarded() {
+    QFutureWatcher<UploadBody> *watcher = static_cast<QFutureWatcher<UploadBody> *>(sender());
+    discardUploadBody(watcher->result());
+    watcher->deleteLater();
+}
+
+// Remove the temporary file (if any) backing a body that won't be posted.
+void LogHandler::discardUploadBody(const UploadBody &body) {
+    if (body.temporary)
+        QFile::remove(body.path);
+}
+
+// Post a prepared request body to the server, and return the reply. The body
+// is streamed from its file, which is owned by the reply. Returns NULL if the
+// body could not be opened.
+//
+// If any of the 'logs' in the body stand in for other logs with the same crash
+// signature, the X-Crash-Signature and X-Crash-Occurrences headers are set.
+// For batches, these hold one comma-separated value per entry, in order.
+QNetworkReply *LogHandler::postUploadBody(const UploadBody &body, const QList<DeviceLog> &logs) {
+    if (body.path.isEmpty())
+        return NULL;
+
+    QFile *f = new QFile(body.path);
+    if (! f->open(QIODevice::ReadOnly)) {
+        qWarning("LogHandler: Unable to open upload body '%s'.", qPrintable(body.path));
+        delete f;
+        discardUploadBody(body);
+        return NULL;
+    }
+
+    QNetworkRequest req;
+    if (body.batch) {
+        req.setUrl(uploadUrl(QLatin1String("/crashreporter/sendbatch")));
+        req.setHeader(QNetworkRequest::ContentTypeHeader, QVariant(QLatin1String("application/x-mumble-crashlog-batch")));
+    } else {
+        req.setUrl(uploadUrl(QLatin1String("/crashreporter/send")));
+        req.setHeader(QNetworkRequest::ContentTypeHeader, QVariant(QLatin1String("application/octet-stream")));
+    }
+    req.setHeader(QNetworkRequest::ContentLengthHeader, QVariant(f->size()));
+    if (body.encoding != PlainEncoding)
+        req.setRawHeader("Content-Encoding", "deflate");
+    if (body.encoding == DictionaryEncoding)
+        req.setRawHeader("X-Crash-Dictionary-Id", qsDictionaryId.toLatin1());
+
+    bool representatives = false;
+    QByteArray signatures;
+    QByteArray occurrences;
+    for (int i = 0; i < logs.count(); i++) {
+        const DeviceLog &log = logs.at(i);
+        if (qhOccurrences.contains(log))
+            representatives = true;
+        if (i > 0) {
+            signatures.append(',');
+            occurrences.append(',');
+        }
+        signatures.append(qhLogSignatures.value(log).toHex());
+        occurrences.append(QByteArray::number(qhOccurrences.value(log, 1)));
+    }
+    if (representatives) {
+        req.setRawHeader("X-Crash-Signature", signatures);
+        req.setRawHeader("X-Crash-Occurrences", occurrences);
+    }
+
+    // The body is handed to the network no faster than the bandwidth limit
+    // allows. The limit is shared by all uploads in flight, and picked up
+    // anew for each one, so changes made while submitting take effect.
+    QIODevice *device = f;
+    utThrottle->setRate(qint64(Settings::get()->uploadRateLimit()) * 1024);
+    if (utThrottle->rate() > 0)
+        device = new ThrottledUploadDevice(f, utThrottle);
+
+    QNetworkReply *reply = qnamAccessManager->post(req, device);
+    device->setParent(reply);
+    reply->setProperty("batch", body.batch);
+    reply->setProperty("encoding", static_cast<int>(body.encoding));
+    reply->setProperty("temporary", body.temporary);
+    return reply;
+}
+
+// Close the body file of a finished reply, and remove it if it was a
+// temporary file.
+void LogHandler::releaseUploadBody(QNetworkReply *reply) {
+    QFile *f = reply->findChild<QFile *>();
+    if (! f)
+        return;
+    f->close();
+    if (reply->property("temporary").toBool())
+        f->remove();
+}
+
+// This is called whenever an upload is finished. In here, we record which
+// logs were successfully uploaded, and refill the upload window. Once all
+// uploads have completed, finishSubmission() is called.
+void LogHandler::uploadFinished() {
+    QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
+    QList<int> indices = qhInFlight.take(reply);
+    QPair<qint64, qint64> bytes = qhUploadBytes.take(reply);
+    releaseUploadBody(reply);
+    reply->deleteLater();
+
+    if (sState != LogHandler::Submitting)
+        return;
+
+    // If the server does not understand the encoding of this body, step
+    // down to the next simpler encoding for the rest of this session, and
+    // send these logs again. Other replies in flight may already have made
+    // us step down, in which case we don't step down any further.
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    UploadEncoding encoding = static_cast<UploadEncoding>(reply->property("encoding").toInt());
+    if (encoding != PlainEncoding && (status == 400 || status == 415)) {
+        qWarning("LogHandler: Server rejected upload encoding %i (HTTP %i). Falling back to a simpler encoding.", encoding, status);
+        if (ueEncoding >= encoding)
+            ueEncoding = static_cast<UploadEncoding>(encoding - 1);
+        qlResendGroups << indices;
+        iBytesPending += uploadGroupSize(indices);
+        fillUploadWindow();
+        return;
+    }
+
+    iBytesDone += bytes.second;
+
+    QSet<int> succeeded;
+    if (reply->error() == QNetworkReply::NoError) {
+        if (reply->property("batch").toBool()) {
+            // One status line per batch entry. Entries that the server
+            // did not report on are treated as failed.
+            QList<QByteArray> lines = reply->readAll().split('\n');
+            for (int i = 0; i < indices.count() && i < lines.count(); i++) {
+                if (lines.at(i).trimmed() == "OK")
+                    succeeded.insert(indices.at(i));
+            }
+        } else {
+            succeeded.insert(indices.first());
+        }
+    }
+
+    uploadGroupFinished(indices, succeeded);
+}
+
+// Book-keeping for a group of logs whose upload has finished, whether
+// successfully or not. Logs that are not in 'succeeded' failed, and are
+// put in the retry queue.
+void LogHandler::uploadGroupFinished(const QList<int> &indices, const QSet<int> &succeeded) {
+    foreach (int idx, indices) {
+        DeviceLog log = qlSubmitList.at(idx);
+        if (succeeded.contains(idx))
+            logSubmitted(log);
+        else
+            rqRetry.add(log, crashLogPath(log), qhLogHashes.value(log));
+        emit crashLogSubmitted(log.first, log.second, succeeded.contains(idx));
+    }
+
+    iFinishedLogs += indices.count();
+    if (iFinishedLogs < qlSubmitList.count())
+        fillUploadWindow();
+    else
+        finishSubmission();
+}
+
+// Record that 'log' was successfully submitted to the server.
+//
+// The log is archived right away, so that quitting (or crashing) in the
+// middle of a submit does not leave already-sent logs behind.
+void LogHandler::logSubmitted(const DeviceLog &log) {
+    qlSubmittedLogs.append(log);
+    sliSubmitted.insert(qhLogHashes.value(log));
+    rqRetry.remove(log);
+    archiveLog(log, crashLogPath(log));
+    releaseTwinLogs(log);
+    releaseSuppressedLogs(log);
+}
+
+// The logs held back by selectRepresentatives() are accounted for once one
+// of their group is known to be on the server, either because we uploaded
+// it, or because the server told us it already had it.
+void LogHandler::releaseSuppressedLogs(const DeviceLog &log) {
+    QByteArray signature = qhLogSignatures.value(log);
+    if (signature.isEmpty() || ! qhSuppressed.contains(signature))
+        return;
+    foreach (DeviceLog suppressed, qhSuppressed.take(signature)) {
+        sliSubmitted.insert(qhLogHashes.value(suppressed));
+        archiveLog(suppressed, crashLogPath(suppressed));
+        releaseTwinLogs(suppressed);
+        emit crashLogSubmitted(suppressed.first, suppressed.second, true);
+    }
+}
+
+// The logs held back by allCrashLogs() for having the same contents as 'log'
+// are archived once 'log' is known to be on the server. Should 'log' fail to
+// make it, they are left in place, and come up again with the next scan.
+void LogHandler::releaseTwinLogs(const DeviceLog &log) {
+    QByteArray hash = qhLogHashes.value(log);
+    if (hash.isEmpty() || ! qhTwins.contains(hash))
+        return;
+    foreach (DeviceLog twin, qhTwins.take(hash)) {
+        qlDuplicateLogs << twin;
+        archiveLog(twin, crashLogPath(twin));
+    }
+}
+
+// Keeps the progress dialog of submitAllCrashLogs() up to date.
+void LogHandler::progressDialogProgress(int finishedLogs, int totalLogs, qint64 bytesSent, qint64 bytesTotal) {
+    Q_UNUSED(bytesSent);
+    Q_UNUSED(bytesTotal);
+
+    if (! qpdProgress)
+        return;
+
+    qpdProgress->setMaximum(totalLogs);
+    qpdProgress->setValue(finishedLogs);
+}
+
+// Called when a submit started by submitAllCrashLogs() is over. Flips the
+// progress dialog into its 'Done' state, or, if there was nothing to submit,
+// tells the user so.
+void LogHandler::progressDialogFinished(int submittedLogs, int failedLogs, bool cancelled) {
+    Q_UNUSED(submittedLogs);
+    Q_UNUSED(failedLogs);
+
+    if (! qpdProgress || cancelled)
+        return;
+
+    if (sState == LogHandler::Ready) {
+        qpdProgress->hide();
+        qelLoop->quit();
+
+        QMessageBox *qmb = new QMessageBox(NULL);
+        qmb->setIcon(QMessageBox::Information);
+        qmb->setWindowTitle(QLatin1String("No logs available"));
+        if (qlDuplicateLogs.isEmpty())
+            qmb->setText(QLatin1String("No crash logs were found on your computer. Nothing to send."));
+        else
+            qmb->setText(QLatin1String("All crash logs found on your computer have already been submitted. Nothing to send."));
+        qmb->exec();
+        delete qmb;
+        return;
+    }
+
+    qpdProgress->setValue(qpdProgress->maximum());
+    qpdProgress->setCancelButtonText(QLatin1String("OK"));
+}
+
+// This is the callback for the 'Cancel' button. The cancel button
+// is re-labeled to 'OK' when all crash logs have been dealt with.
+void LogHandler::logSubmitCancelled() {
+    QList<DeviceLog> failedSubmits;
+
+    // We were cancelled while we were uploading.
+    if (sState == LogHandler::Submitting) {
+        cancelSubmittingCrashLogs();
+    // We were OK'd away.
+    } else {
+        // Compile a list of non-successful submits that we can use
+        // to show the user later on.
+        foreach (DeviceLog log, qlSubmitList) {
+            if (! qlSubmittedLogs.contains(log))
+                failedSubmits << log;
+        }
+    }
+
+    qelLoop->quit();
+
+    // Did any of our submits fail? If so, show
+    // a dialog explaining the user what went wrong.
+    if (failedSubmits.count() > 0) {
+        QMessageBox *qmb = new QMessageBox(NULL);
+        qmb->setIcon(QMessageBox::Warning);
+        qmb->setWindowTitle(QString("Warning"));
+        qmb->setText(QString("An error occured while submitting some of your crash logs.\n"
+                             "The crash logs that were not sent to the server are still kept on your computer.\n"
+                             "They will be submitted again automatically while the crash reporter is running.\n"
+                             "\n"
+                             "If the problem persists, please file a bug on the Mumble for iOS Bug Tracker.\n"));
+        qmb->exec();
+        delete qmb;
+    }
+}
+
+// Returns the current state of our operation. See
+// LogHandler::State (enum).
+//
+// Callable from JavaScript.
+LogHandler::State LogHandler::currentState() const {
+    return sState;
+}
+
+// Reset us to the Ready state.
+//
+// Callable from JavaScript.
+void LogHandler::resetState() {
+    sState = LogHandler::Ready;
+}
+
+// Move the submitted crash log 'log', found at 'path', into the submitted
+// logs directory. The move happens on a worker thread; see moveLogToArchive().
+void LogHandler::archiveLog(const DeviceLog &log, const QString &path) const {
+    if (qslCrashLogDirs.isEmpty()) {
+        qWarning("LogHandler: Empty crash log dir. Not removing logs.");
+        return;
+    }
+
+    QtConcurrent::run(&LogHandler::moveLogToArchive, qsSubmittedCrashLogDir, log, path);
+}
+
+// Move the crash log 'log', found at 'path', into the archive directory
+// 'archiveDir'. Returns true on success. This runs on a worker thread.
+//
+// This does not actually *remove* the log from the system, but merely
+// moves it into our own directory in %APPDATA% or ~/Library/Application
+// Data/ depending on the platform.
+//
+// When the submitted logs directory is on the same volume as the iTunes
+// crash log directory (the common case), this is a single atomic rename,
+// so the log is never read or written. Otherwise, QFile::rename() falls
+// back to copying the log and removing the original.
+bool LogHandler::moveLogToArchive(const QString &archiveDir, const DeviceLog &log, const QString &path) {
+    if (archiveDir.isEmpty()) {
+        qWarning("LogHandler: Empty submit dir. Not removing logs.");
+        return false;
+    }
+
+    QDir d(archiveDir);
+    if (! d.exists(log.first)) {
+        if (! d.mkpath(log.first)) {
+            qWarning("LogHandler: Failed to mkpath '%s'. Skipping log.", qPrintable(log.first));
+            return false;
+        }
+    }
+    if (! d.cd(log.first)) {
+        qWarning("LogHandler: Could not change to device directory. Skipping log.");
+        return false;
+    }
+
+    // Neither rename() nor the copy fallback overwrite existing files.
+    QString target = d.filePath(log.second);
+    if (QFile::exists(target) && ! QFile::remove(target)) {
+        qWarning("LogHandler: Unable to replace previously archived '%s'. Skipping log.", qPrintable(log.second));
+        return false;
+    }
+
+    if (! QFile::rename(path, target)) {
+        qWarning("LogHandler: Unable to move '%s' into the submitted logs directory.", qPrintable(log.second));
+        return false;
+    }
+
+    qWarning("LogHandler: %s successfully removed.", qPrintable(log.second));
+    return true;
+}
+
+// Returns the encoding that uploads should start out with, according
+// to the user's settings.
+UploadEncoding LogHandler::preferredEncoding() const {
+    if (! Settings::get()->compressUploads())
+        return PlainEncoding;
+    if (qbaDictionary.isEmpty())
+        return DeflateEncoding;
+    return DictionaryEncoding;
+}
+
+// Is a background retry of 'log' currently in progress?
+bool LogHandler::retryInFlight(const DeviceLog &log) const {
+    foreach (RetryEntry entry, qhRetryPreparing) {
+        if (entry.log == log)
+            return true;
+    }
+    foreach (RetryEntry entry, qhRetryInFlight) {
+        if (entry.log == log)
+            return true;
+    }
+    return false;
+}
+
+// Arm the retry timer for the earliest scheduled retry in the retry
+// queue. Does nothing while retries are in flight; the last one to
+// finish calls us again.
+void LogHandler::scheduleRetry() {
+    if (! bBackgroundWork)
+        return;
+    if (! qhRetryPreparing.isEmpty() || ! qhRetryInFlight.isEmpty())
+        return;
+
+    uint next = rqRetry.nextRetryTime();
+    if (next == 0) {
+        qtRetryTimer->stop();
+        return;
+    }
+
+    uint now = QDateTime::currentDateTime().toTime_t();
+    uint secs = (next > now) ? qMin(next - now, 24U * 60U * 60U) : 0U;
+    qtRetryTimer->start(static_cast<int>(secs * 1000));
+}
+
+// Start background retries of the logs in the retry queue that are due.
+// These reuse the path and hash stored in the queue, so no rescan of the
+// crash log directories is needed.
+void LogHandler::drainRetryQueue() {
+    // Without a network access manager, we can't submit anything. And
+    // while the user is submitting, we don't want to get in the way;
+    // the submit will pick up any pending logs anyway.
+    if (! qnamAccessManager || sState == LogHandler::Submitting) {
+        qtRetryTimer->start(60 * 1000);
+        return;
+    }
+
+    int window = Settings::get()->maxConcurrentUploads();
+    foreach (RetryEntry entry, rqRetry.dueEntries(QDateTime::currentDateTime().toTime_t())) {
+        if (qhRetryPreparing.count() + qhRetryInFlight.count() >= window)
+            break;
+        if (retryInFlight(entry.log))
+            continue;
+
+        // The log is gone (the user may have removed it, or a manual
+        // submit archived it). Nothing left to retry.
+        if (! QFile::exists(entry.path)) {
+            rqRetry.remove(entry.log);
+            continue;
+        }
+
+        UploadEntry upload;
+        upload.log = entry.log;
+        upload.path = entry.path;
+
+        QFutureWatcher<UploadBody> *watcher = new QFutureWatcher<UploadBody>(this);
+        qhRetryPreparing.insert(watcher, entry);
+        QObject::connect(watcher, SIGNAL(finished()), this, SLOT(retryBodyReady()));
+        watcher->setFuture(QtConcurrent::run(&LogHandler::prepareUploadBody, QList<UploadEntry>() << upload, false, ueRetryEncoding, qbaDictionary));
+    }
+
+    scheduleRetry();
+}
+
+// Called when the body for a background retry has been prepared.
+void LogHandler::retryBodyReady() {
+    QFutureWatcher<UploadBody> *watcher = static_cast<QFutureWatcher<UploadBody> *>(sender());
+    RetryEntry entry = qhRetryPreparing.take(watcher);
+    UploadBody body = watcher->result();
+    watcher->deleteLater();
+
+    QNetworkReply *reply = postUploadBody(body);
+    if (! reply) {
+        rqRetry.add(entry.log, entry.path, entry.hash);
+        scheduleRetry();
+        return;
+    }
+    qhRetryInFlight.insert(reply, entry);
+    QObject::connect(reply, SIGNAL(finished()), this, SLOT(retryFinished()));
+}
+
+// Called when a background retry has finished. On success, the log is
+// archived just as if it had been submitted manually. On failure, its
+// next retry is pushed further into the future.
+void LogHandler::retryFinished() {
+    QNetworkReply *reply = static_cast<QNetworkReply *>(sender());
+    RetryEntry entry = qhRetryInFlight.take(reply);
+    releaseUploadBody(reply);
+    reply->deleteLater();
+
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    UploadEncoding encoding = static_cast<UploadEncoding>(reply->property("encoding").toInt());
+    if (encoding != PlainEncoding && (status == 400 || status == 415)) {
+        // The server did not understand the encoding. This does not
+        // count as a failed attempt; step down, and go again.
+        if (ueRetryEncoding >= encoding)
+            ueRetryEncoding = static_cast<UploadEncoding>(encoding - 1);
+        if (! qtRetryTimer->isActive())
+            qtRetryTimer->start(0);
+        return;
+    }
+
+    if (reply->error() == QNetworkReply::NoError) {
+        qWarning("LogHandler: '%s' submitted on retry.", qPrintable(entry.log.second));
+        sliSubmitted.insert(entry.hash);
+        rqRetry.remove(entry.log);
+        archiveLog(entry.log, entry.path);
+        releaseTwinLogs(entry.log);
+    } else {
+        rqRetry.add(entry.log, entry.path, entry.hash);
+    }
+
+    scheduleRetry();
 }
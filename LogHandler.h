@@ -34,7 +34,97 @@
 #include <QtGui/QtGui>
 #include <QtNetwork/QtNetwork>
 
-typedef QPair<QString, QString> DeviceLog;
+#include "DeviceLog.h"
+#include "SubmittedLogIndex.h"
+#include "RetryQueue.h"
+#include "CrashLogManifest.h"
+#include "CrashLogSearchIndex.h"
+#include "CrashLogCatalog.h"
+#include "CrashFileChunkReader.h"
+#include "UploadThrottle.h"
+
+// The size and modification time of a crash log, as seen by the
+// crash log directory watcher.
+typedef QPair<qint64, uint> CrashLogStamp;
+
+// What a scan of the crash log directories should gather besides the
+// listing of devices and their crash logs. Stamps are only taken for
+// devices that are not in 'knownDevices', or that are in 'dirtyDevices'.
+// Signatures require each log to be parsed. If 'catalog' is set, the
+// catalog entry of each log is looked up, so uploads can be prioritized.
+// With 'cachedEntries', only entries the catalog already has for logs
+// whose stamps match are returned, and nothing is parsed; this needs
+// 'stamps', and no 'knownDevices'.
+struct CrashLogScanRequest {
+    QStringList crashLogDirs;
+    QStringList applications;
+    QSet<QString> knownDevices;
+    QSet<QString> dirtyDevices;
+    bool stamps;
+    bool hashes;
+    bool signatures;
+    CrashLogCatalog *catalog;
+    bool cachedEntries;
+};
+
+// The result of a scan of the crash log directories, as performed by
+// LogHandler::scanCrashLogs() on a worker thread. A device may have a
+// directory in more than one of the crash log directories; its crash
+// logs are merged, and 'paths' tells where each of them lives.
+struct CrashLogScan {
+    QStringList devices;
+    QMap<QString, QStringList> files;
+    QHash<QString, QStringList> deviceDirs;
+    QHash<DeviceLog, QString> paths;
+    QHash<QString, QHash<QString, CrashLogStamp> > stamps;
+    QHash<DeviceLog, QByteArray> hashes;
+    QHash<DeviceLog, qint64> sizes;
+    QHash<DeviceLog, QByteArray> signatures;
+    QHash<DeviceLog, CatalogEntry> entries;
+};
+
+// One crash log directory to be listed by LogHandler::listCrashLogDirectory(),
+// possibly alongside others on other threads. If 'deviceName' is set, only
+// that device is listed.
+struct CrashLogDirectoryTask {
+    CrashLogManifest *manifest;
+    QString crashLogDir;
+    QStringList applications;
+    QString deviceName;
+};
+
+// What LogHandler::indexCrashLogs() should bring up to date on a worker
+// thread, and where to find the crash logs to do so.
+struct CrashLogIndexRequest {
+    CrashLogManifest *manifest;
+    CrashLogSearchIndex *index;
+    CrashLogCatalog *catalog;
+    QStringList crashLogDirs;
+    QStringList applications;
+    QString submittedDir;
+};
+
+// A crash log that is about to be uploaded, along with its absolute
+// path on disk. Upload bodies are prepared on a worker thread, which
+// only ever touches the path.
+struct UploadEntry {
+    DeviceLog log;
+    QString path;
+};
+
+// How upload bodies are encoded. When the server rejects an encoding,
+// we step down to the next simpler one.
+enum UploadEncoding { PlainEncoding, DeflateEncoding, DictionaryEncoding };
+
+// A request body, as prepared by LogHandler::prepareUploadBody(). Bodies
+// live on disk: either the crash log itself, or a temporary file holding
+// a batch and/or compressed data.
+struct UploadBody {
+    QString path;
+    bool temporary;
+    UploadEncoding encoding;
+    bool batch;
+};
 
 class LogHandler : public QObject {
         Q_OBJECT
@@ -46,17 +136,24 @@ class LogHandler : public QObject {
         LogHandler(QObject *p = NULL);
         ~LogHandler();
         void setNetworkAccessManager(QNetworkAccessManager *qnam);
+        void setDryRun(bool b);
+        void startBackgroundWork();
+        CrashLogScan scanCrashLogCatalog();
         QNetworkAccessManager *networkAccessManager() const;
         static void showSubmittedCrashLogs();
         static void deleteSubmittedCrashLogs();
-        static QString crashLogDirectory();
+        static QStringList crashLogDirectories();
         static QString submittedCrashLogDirectory();
 
     protected:
         State sState;
         QNetworkAccessManager *qnamAccessManager;
-        QString qsCrashLogDir;
+        bool bBackgroundWork;
+        QStringList qslCrashLogDirs;
+        QStringList qslApplications;
         QString qsSubmittedCrashLogDir;
+        SubmittedLogIndex sliSubmitted;
+        CrashLogManifest clmManifest;
 
         // 'Safe' device names and file names (for a device). Calls to
         // the methods:
@@ -69,27 +166,209 @@ class LogHandler : public QObject {
         // also check against these values when accessing files from disk
         // to pervent malicious JavaScript from reading arbitrary files from
         // the users harddrive.
-        QMap<QString, QStringList> qmSafeDeviceFiles;
-        QStringList qslSafeDeviceNames;
+        //
+        // The file names are kept both as a set, for checking, and in
+        // listing order, for handing out pages of them. Logs listed that
+        // way are identified by integer handles, which are resolved and
+        // checked without walking any lists.
+        QHash<QString, QSet<QString> > qhSafeDeviceFiles;
+        QHash<DeviceLog, QString> qhLogPaths;
+        QHash<QString, QStringList> qhDeviceDirs;
+        QHash<QString, QStringList> qhSafeDeviceListings;
+        QSet<QString> qsetSafeDeviceNames;
+        QHash<int, DeviceLog> qhHandleLogs;
+        QHash<DeviceLog, int> qhLogHandles;
+        int iNextHandle;
+        bool isSafeCrashLog(const QString &deviceName, const QString &fileName) const;
+        void setSafeCrashLogs(const QString &deviceName, const QStringList &fileNames);
+        int handleForCrashLog(const DeviceLog &log);
+        DeviceLog crashLogForHandle(int handle) const;
 
-        QFileInfoList crashLogPathsForApplication(const QString &deviceName, const QString &appName) const;
-        QList<DeviceLog> allCrashLogs();
-        void submitNextLog();
-        void removeSubmittedLogs() const;
+        // Crash logs opened for chunked reads by openCrashFile(). Their
+        // handles start at PreviewHandleBase, well above the crash log
+        // handles counted up from 1 by handleForCrashLog(), so the page
+        // can't pass one kind of handle where the other is expected.
+        static const int PreviewHandleBase = 0x40000000;
+        CrashFileChunkReader cfcrPreview;
+
+        static QStringList crashReporterDevices(CrashLogManifest *manifest, const QString &crashLogDir);
+        static QStringList crashLogFilesForApplications(CrashLogManifest *manifest, const QString &deviceDir, const QStringList &appNames);
+        static CrashLogScan listCrashLogDirectory(const CrashLogDirectoryTask &task);
+        static CrashLogScan listCrashLogs(CrashLogManifest *manifest, const QStringList &crashLogDirs, const QStringList &appNames, const QString &deviceName = QString());
+        static CrashLogScan scanCrashLogs(CrashLogManifest *manifest, const CrashLogScanRequest &request);
+        static QByteArray readCrashFile(const QString &path);
+        static QString readCrashFileAsString(const QString &path);
+        static QVariantMap summarizeCrashFile(const QString &path);
+        void applyCrashLogScan(const CrashLogScan &scan);
+        QList<DeviceLog> allCrashLogs(const CrashLogScan &scan);
+        QString crashLogPath(const DeviceLog &log) const;
+        QUrl uploadUrl(const QString &path) const;
+        void negotiateUploads();
+        void finishSubmission();
+        QList<int> takeNextUploadGroup();
+        void fillUploadWindow();
+        void startUpload(const QList<int> &indices);
+        static UploadBody prepareUploadBody(const QList<UploadEntry> &entries, bool batch, UploadEncoding encoding, const QByteArray &dictionary);
+        void logSubmitted(const DeviceLog &log);
+        void releaseSuppressedLogs(const DeviceLog &log);
+        void releaseTwinLogs(const DeviceLog &log);
+        void archiveLog(const DeviceLog &log, const QString &path) const;
+        static bool moveLogToArchive(const QString &archiveDir, const DeviceLog &log, const QString &path);
+        UploadEncoding preferredEncoding() const;
+        QNetworkReply *postUploadBody(const UploadBody &body, const QList<DeviceLog> &logs = QList<DeviceLog>());
+        void releaseUploadBody(QNetworkReply *reply);
+        void discardUploadBody(const UploadBody &body);
+        void uploadGroupFinished(const QList<int> &indices, const QSet<int> &succeeded);
+        qint64 uploadGroupSize(const QList<int> &indices) const;
+        void selectRepresentatives();
+        void prioritizeSubmitList(const CrashLogScan &scan);
+        void emitSubmitProgress();
 
     //
     // State and methods related to the submission process.
     //
     protected:
         QList<DeviceLog> qlSubmitList;
-        int iCurrentLog;
+        int iNextLog;
+        int iFinishedLogs;
+        int iMaxInFlight;
+        bool bBatchUploads;
+        int iBatchMaxLogs;
+        qint64 iBatchMaxBytes;
+        UploadEncoding ueEncoding;
+        QByteArray qbaDictionary;
+        QString qsDictionaryId;
+        QHash<QFutureWatcher<UploadBody> *, QList<int> > qhPreparing;
+        QHash<QNetworkReply *, QList<int> > qhInFlight;
+        QFutureWatcher<CrashLogScan> *qfwSubmitScan;
+        QList<QList<int> > qlResendGroups;
+        QNetworkReply *qnrNegotiation;
         QList<DeviceLog> qlSubmittedLogs;
+        QList<DeviceLog> qlDuplicateLogs;
+        QHash<DeviceLog, QByteArray> qhLogHashes;
+        QHash<DeviceLog, qint64> qhLogSizes;
+        bool bRepresentatives;
+        bool bDryRun;
+        int iRepresentatives;
+        QHash<DeviceLog, QByteArray> qhLogSignatures;
+        QHash<DeviceLog, int> qhOccurrences;
+        QHash<QByteArray, QList<DeviceLog> > qhSuppressed;
+        QHash<QByteArray, QList<DeviceLog> > qhTwins;
+        QHash<QNetworkReply *, QPair<qint64, qint64> > qhUploadBytes;
+        qint64 iBytesDone;
+        qint64 iBytesPending;
+        UploadThrottle *utThrottle;
+    protected slots:
+        void submitScanFinished();
+        void negotiationFinished();
+        void uploadBodyReady();
+        void uploadBodyDiscarded();
+        void uploadProgressed(qint64 bytesSent, qint64 bytesTotal);
+        void uploadFinished();
+
+    //
+    // State and methods related to the modal progress dialog shown
+    // by submitAllCrashLogs().
+    //
+    protected:
         QEventLoop *qelLoop;
         QProgressDialog *qpdProgress;
     protected slots:
-        void uploadFinished();
+        void progressDialogProgress(int finishedLogs, int totalLogs, qint64 bytesSent, qint64 bytesTotal);
+        void progressDialogFinished(int submittedLogs, int failedLogs, bool cancelled);
         void logSubmitCancelled();
 
+    //
+    // State and methods related to retrying failed submissions
+    // in the background.
+    //
+    protected:
+        RetryQueue rqRetry;
+        QTimer *qtRetryTimer;
+        UploadEncoding ueRetryEncoding;
+        QHash<QFutureWatcher<UploadBody> *, RetryEntry> qhRetryPreparing;
+        QHash<QNetworkReply *, RetryEntry> qhRetryInFlight;
+        bool retryInFlight(const DeviceLog &log) const;
+        void scheduleRetry();
+    protected slots:
+        void drainRetryQueue();
+        void retryBodyReady();
+        void retryFinished();
+
+    //
+    // State and methods related to watching the crash log directory
+    // for new, changed and removed crash logs.
+    //
+    protected:
+        QFileSystemWatcher *qfswWatcher;
+        QTimer *qtRescanTimer;
+        QSet<QString> qsetChangedDirs;
+        QHash<QString, QHash<QString, CrashLogStamp> > qhKnownLogs;
+        QFutureWatcher<CrashLogScan> *qfwWatchScan;
+        bool bWatchPrimed;
+        bool bRescanPending;
+        void watchCrashLogDirectory();
+        void diffCrashLogStamps(const QString &deviceName, const QHash<QString, CrashLogStamp> &stamps);
+    protected slots:
+        void crashLogDirectoryChanged(const QString &path);
+        void rescanCrashLogDirectory();
+        void watchScanFinished();
+
+    //
+    // State related to the asynchronous JavaScript-exported methods.
+    //
+    protected:
+        QHash<QFutureWatcher<QString> *, DeviceLog> qhReading;
+        QHash<QFutureWatcher<QVariantMap> *, DeviceLog> qhSummarizing;
+        QHash<QFutureWatcher<QStringList> *, QString> qhSearching;
+        QHash<QFutureWatcher<CatalogPage> *, int> qhQuerying;
+    protected slots:
+        void crashLogsScanned();
+        void crashLogSnapshotScanned();
+        void crashFileRead();
+        void crashFileSummarized();
+        void searchFinished();
+        void crashLogQueryFinished();
+
+    //
+    // State and methods related to the full-text search index over
+    // both the crash log directory and the submitted logs directory,
+    // and the metadata catalog of the crash log directory.
+    //
+    protected:
+        CrashLogSearchIndex csiSearch;
+        CrashLogCatalog clcCatalog;
+        QFutureWatcher<void> *qfwIndexing;
+        bool bIndexPending;
+        void updateSearchIndex();
+        static void indexCrashLogs(const CrashLogIndexRequest &request);
+    protected slots:
+        void searchIndexUpdated();
+
+    //
+    // Signals emitted as crash logs come and go, and with the
+    // results of the asynchronous JavaScript-exported methods. These
+    // are reachable from JavaScript through the injected object.
+    //
+    signals:
+        void crashDeviceAdded(const QString &deviceName);
+        void crashDeviceRemoved(const QString &deviceName);
+        void crashLogAdded(const QString &deviceName, const QString &fileName);
+        void crashLogChanged(const QString &deviceName, const QString &fileName);
+        void crashLogRemoved(const QString &deviceName, const QString &fileName);
+        void crashLogsAvailable(const QVariantMap &crashLogs);
+        void crashLogSnapshotAvailable(const QVariantMap &snapshot);
+        void crashFileContentsAvailable(const QString &deviceName, const QString &fileName, const QString &contents);
+        void crashFileSummaryAvailable(const QString &deviceName, const QString &fileName, const QVariantMap &summary);
+        void searchResultsAvailable(const QString &query, const QVariantList &results);
+        void crashLogQueryResults(const QVariantMap &results);
+        void crashLogCatalogUpdated();
+        void submitStatusChanged(const QString &status);
+        void submitProgress(int finishedLogs, int totalLogs, qint64 bytesSent, qint64 bytesTotal);
+        void crashLogSubmitted(const QString &deviceName, const QString &fileName, bool success);
+        void crashLogQueued(const QString &deviceName, const QString &fileName);
+        void submitFinished(int submittedLogs, int failedLogs, bool cancelled);
+
     //
     // JavaScript-exported methods.
     //
@@ -98,7 +377,22 @@ class LogHandler : public QObject {
         QStringList crashFilesForDevice(const QString &deviceName);
         QByteArray contentsOfCrashFile(const QString &deviceName, const QString &fileName) const;
         QString contentsOfCrashFileAsString(const QString &deviceName, const QString &fileName) const;
+        QVariantMap crashFilePageForDevice(const QString &deviceName, int offset, int limit);
+        QString contentsOfCrashHandle(int handle) const;
+        QVariantMap openCrashFile(const QString &deviceName, const QString &fileName);
+        QString readCrashFileChunks(int handle, int firstChunk, int chunkCount);
+        void closeCrashFile(int handle);
+        void requestCrashLogs();
+        void requestCrashLogSnapshot();
+        void requestContentsOfCrashFile(const QString &deviceName, const QString &fileName);
+        void requestSummaryOfCrashFile(const QString &deviceName, const QString &fileName);
+        void requestContentsOfCrashHandle(int handle);
+        void requestSummaryOfCrashHandle(int handle);
+        void requestSearch(const QString &query, int limit);
+        void requestCrashLogQuery(const QVariantMap &query);
         void submitAllCrashLogs();
+        bool startSubmittingCrashLogs();
+        void cancelSubmittingCrashLogs();
         State currentState() const;
         void resetState();
 
@@ -0,0 +1,198 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "RetryQueue.h"
+
+#include <QtGui/QtGui>
+
+#include <string.h>
+
+static const char QueueMagic[4] = { 'M', 'R', 'T', 'Q' };
+static const quint32 QueueVersion = 1;
+
+// Backoff parameters (in seconds). The first retry happens after about
+// a minute, and the delay doubles with each failed attempt, up to six
+// hours. Logs that keep failing are eventually given up on; they remain
+// in the iTunes crash log directory, so a manual submit can still send
+// them.
+static const uint BackoffBase = 60;
+static const uint BackoffMax = 6 * 60 * 60;
+static const quint32 MaxAttempts = 20;
+
+RetryQueue::RetryQueue(const QString &path) {
+    qsPath = path;
+    qsrand(QDateTime::currentDateTime().toTime_t());
+    load();
+}
+
+RetryQueue::~RetryQueue() {
+}
+
+// Get the path of the on-disk retry queue.
+QString RetryQueue::defaultQueuePath() {
+    QString path = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+    QDir d;
+    d.mkpath(path);
+    return QDir(path).absoluteFilePath(QLatin1String("RetryQueue.dat"));
+}
+
+// Returns the delay (in seconds) before the next retry of a log that
+// has failed 'attempts' times. The delay is picked at random from the
+// upper half of the backoff interval.
+uint RetryQueue::backoffDelay(quint32 attempts) {
+    uint delay = BackoffMax;
+    if (attempts > 0 && attempts <= 16)
+        delay = qMin(BackoffBase << (attempts - 1), BackoffMax);
+    uint jitter = static_cast<uint>(qrand()) % (delay / 2 + 1);
+    return delay / 2 + jitter;
+}
+
+void RetryQueue::load() {
+    QFile f(qsPath);
+    if (! f.exists())
+        return;
+
+    if (! f.open(QIODevice::ReadOnly)) {
+        qWarning("RetryQueue: Unable to open queue for reading.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[4];
+    quint32 version = 0;
+    quint32 count = 0;
+    if (qds.readRawData(magic, 4) != 4 || memcmp(magic, QueueMagic, 4) != 0) {
+        qWarning("RetryQueue: Queue has bad magic. Ignoring.");
+        return;
+    }
+    qds >> version;
+    if (version != QueueVersion) {
+        qWarning("RetryQueue: Unknown queue version %u. Ignoring.", version);
+        return;
+    }
+
+    qds >> count;
+    for (quint32 i = 0; i < count && qds.status() == QDataStream::Ok; i++) {
+        RetryEntry entry;
+        qds >> entry.log.first >> entry.log.second >> entry.path >> entry.hash >> entry.attempts >> entry.nextRetry;
+        if (qds.status() == QDataStream::Ok)
+            qhEntries.insert(entry.log, entry);
+    }
+
+    f.close();
+}
+
+void RetryQueue::save() const {
+    QFile f(qsPath);
+    if (qhEntries.isEmpty()) {
+        f.remove();
+        return;
+    }
+
+    if (! f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning("RetryQueue: Unable to open queue for writing.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+
+    qds.writeRawData(QueueMagic, 4);
+    qds << QueueVersion;
+    qds << static_cast<quint32>(qhEntries.count());
+    foreach (RetryEntry entry, qhEntries) {
+        qds << entry.log.first << entry.log.second << entry.path << entry.hash << entry.attempts << entry.nextRetry;
+    }
+
+    f.close();
+}
+
+// Record a failed submission of 'log', and schedule its next retry.
+void RetryQueue::add(const DeviceLog &log, const QString &path, const QByteArray &hash) {
+    RetryEntry entry;
+    if (qhEntries.contains(log)) {
+        entry = qhEntries.value(log);
+    } else {
+        entry.log = log;
+        entry.attempts = 0;
+    }
+    entry.path = path;
+    entry.hash = hash;
+    entry.attempts += 1;
+
+    if (entry.attempts > MaxAttempts) {
+        qWarning("RetryQueue: Giving up on '%s' after %u attempts.", qPrintable(log.second), MaxAttempts);
+        remove(log);
+        return;
+    }
+
+    entry.nextRetry = QDateTime::currentDateTime().toTime_t() + backoffDelay(entry.attempts);
+    qhEntries.insert(log, entry);
+    save();
+}
+
+// Remove 'log' from the queue, e.g. because it was submitted.
+void RetryQueue::remove(const DeviceLog &log) {
+    if (qhEntries.remove(log) > 0)
+        save();
+}
+
+bool RetryQueue::contains(const DeviceLog &log) const {
+    return qhEntries.contains(log);
+}
+
+bool RetryQueue::isEmpty() const {
+    return qhEntries.isEmpty();
+}
+
+// Returns all entries that are due for a retry at time 'now'
+// (in seconds since the epoch).
+QList<RetryEntry> RetryQueue::dueEntries(uint now) const {
+    QList<RetryEntry> due;
+    foreach (RetryEntry entry, qhEntries) {
+        if (entry.nextRetry <= now)
+            due << entry;
+    }
+    return due;
+}
+
+// Returns the time (in seconds since the epoch) of the earliest
+// scheduled retry, or 0 if the queue is empty.
+uint RetryQueue::nextRetryTime() const {
+    uint next = 0;
+    foreach (RetryEntry entry, qhEntries) {
+        if (next == 0 || entry.nextRetry < next)
+            next = entry.nextRetry;
+    }
+    return next;
+}
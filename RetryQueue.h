@@ -0,0 +1,75 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __RETRYQUEUE_H__
+#define __RETRYQUEUE_H__
+
+#include <QtCore/QtCore>
+
+#include "DeviceLog.h"
+
+// A crash log whose submission failed, and which should be retried.
+// We keep the absolute path and content hash of the log around, so
+// retrying does not require rescanning the crash log directories.
+struct RetryEntry {
+    DeviceLog log;
+    QString path;
+    QByteArray hash;
+    quint32 attempts;
+    uint nextRetry;
+};
+
+// A persistent queue of crash logs whose submission failed.
+//
+// Each failed attempt pushes the next retry of a log further into the
+// future, using exponential backoff with random jitter, so that many
+// clients that lost their connection at the same time don't all come
+// back at once. The queue is stored in the application's data directory,
+// and is rewritten whenever it changes.
+class RetryQueue {
+    protected:
+        QString qsPath;
+        QHash<DeviceLog, RetryEntry> qhEntries;
+        void load();
+        void save() const;
+
+    public:
+        RetryQueue(const QString &path = RetryQueue::defaultQueuePath());
+        ~RetryQueue();
+        void add(const DeviceLog &log, const QString &path, const QByteArray &hash);
+        void remove(const DeviceLog &log);
+        bool contains(const DeviceLog &log) const;
+        bool isEmpty() const;
+        QList<RetryEntry> dueEntries(uint now) const;
+        uint nextRetryTime() const;
+        static uint backoffDelay(quint32 attempts);
+        static QString defaultQueuePath();
+};
+
+#endif
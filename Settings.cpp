@@ -29,6 +29,8 @@
 
 #include "Settings.h"
 
+#include <QtGui/QtGui>
+
 Settings *Settings::singleton = NULL;
 
 static QNetworkProxy::ProxyType local_to_qt_proxy(int type) {
@@ -143,3 +145,156 @@ QString Settings::proxyPassword() {
 bool Settings::verboseJavaScriptErrors() {
     return qsSettings->value(QLatin1String("Browser/VerboseJSErrors")).toBool();
 }
+
+// Set the maximum number of crash log uploads kept in flight at once
+void Settings::setMaxConcurrentUploads(int n) {
+    qsSettings->setValue(QLatin1String("Network/Upload/MaxConcurrent"), n);
+}
+
+// Get the maximum number of crash log uploads kept in flight at once
+int Settings::maxConcurrentUploads() {
+    int n = qsSettings->value(QLatin1String("Network/Upload/MaxConcurrent"), 4).toInt();
+    return qMax(n, 1);
+}
+
+// Set the base URL of the crash reporter server that logs are submitted to
+void Settings::setUploadServer(const QString &url) {
+    qsSettings->setValue(QLatin1String("Network/Upload/Server"), url);
+}
+
+// Get the base URL of the crash reporter server that logs are submitted to.
+// Pointing this at a local endpoint is useful when testing the upload code.
+QString Settings::uploadServer() {
+    return qsSettings->value(QLatin1String("Network/Upload/Server"), QLatin1String("https://mumble-ios.appspot.com")).toString();
+}
+
+// Set whether crash logs are submitted in batches
+void Settings::setBatchUploads(bool b) {
+    qsSettings->setValue(QLatin1String("Network/Upload/Batch"), b);
+}
+
+// Get whether crash logs are submitted in batches
+bool Settings::batchUploads() {
+    return qsSettings->value(QLatin1String("Network/Upload/Batch"), false).toBool();
+}
+
+// Set the maximum number of crash logs packed into a single batch
+void Settings::setBatchMaxLogs(int n) {
+    qsSettings->setValue(QLatin1String("Network/Upload/BatchMaxLogs"), n);
+}
+
+// Get the maximum number of crash logs packed into a single batch
+int Settings::batchMaxLogs() {
+    int n = qsSettings->value(QLatin1String("Network/Upload/BatchMaxLogs"), 32).toInt();
+    return qMax(n, 1);
+}
+
+// Set the maximum size (in bytes) of a single batch
+void Settings::setBatchMaxBytes(int n) {
+    qsSettings->setValue(QLatin1String("Network/Upload/BatchMaxBytes"), n);
+}
+
+// Get the maximum size (in bytes) of a single batch
+int Settings::batchMaxBytes() {
+    int n = qsSettings->value(QLatin1String("Network/Upload/BatchMaxBytes"), 1024*1024).toInt();
+    return qMax(n, 1);
+}
+
+// Set whether crash log uploads are compressed
+void Settings::setCompressUploads(bool b) {
+    qsSettings->setValue(QLatin1String("Network/Upload/Compress"), b);
+}
+
+// Get whether crash log uploads are compressed. Off unless enabled, as a
+// server that ignores Content-Encoding would store the compressed data.
+bool Settings::compressUploads() {
+    return qsSettings->value(QLatin1String("Network/Upload/Compress"), false).toBool();
+}
+
+// Set whether we ask the server which logs it already has before uploading
+void Settings::setNegotiateUploads(bool b) {
+    qsSettings->setValue(QLatin1String("Network/Upload/Negotiate"), b);
+}
+
+// Get whether we ask the server which logs it already has before uploading.
+// Off unless enabled, as not every server has the endpoint.
+bool Settings::negotiateUploads() {
+    return qsSettings->value(QLatin1String("Network/Upload/Negotiate"), false).toBool();
+}
+
+// Set whether only a few representatives of each crash signature are uploaded
+void Settings::setUploadRepresentatives(bool b) {
+    qsSettings->setValue(QLatin1String("Network/Upload/Representatives"), b);
+}
+
+// Get whether only a few representatives of each crash signature are uploaded
+bool Settings::uploadRepresentatives() {
+    return qsSettings->value(QLatin1String("Network/Upload/Representatives"), false).toBool();
+}
+
+// Set the number of logs uploaded for each crash signature
+void Settings::setRepresentativesPerSignature(int n) {
+    qsSettings->setValue(QLatin1String("Network/Upload/RepresentativesPerSignature"), n);
+}
+
+// Get the number of logs uploaded for each crash signature
+int Settings::representativesPerSignature() {
+    int n = qsSettings->value(QLatin1String("Network/Upload/RepresentativesPerSignature"), 3).toInt();
+    return qMax(n, 1);
+}
+
+// Set the directory symbol maps for offline symbolication are loaded from
+void Settings::setSymbolsDirectory(const QString &path) {
+    qsSettings->setValue(QLatin1String("Symbolication/Directory"), path);
+}
+
+// Get the directory symbol maps for offline symbolication are loaded from
+QString Settings::symbolsDirectory() {
+    QString defaultDir = QDir(QDesktopServices::storageLocation(QDesktopServices::DataLocation)).absoluteFilePath(QLatin1String("Symbols"));
+    return qsSettings->value(QLatin1String("Symbolication/Directory"), defaultDir).toString();
+}
+
+// Set the memory budget, in kilobytes, for decoded crash log chunks kept around for previews
+void Settings::setPreviewCacheSize(int kb) {
+    qsSettings->setValue(QLatin1String("Preview/CacheSize"), kb);
+}
+
+// Get the memory budget, in kilobytes, for decoded crash log chunks kept around for previews
+int Settings::previewCacheSize() {
+    int kb = qsSettings->value(QLatin1String("Preview/CacheSize"), 8192).toInt();
+    return qMax(kb, 64);
+}
+
+// Set extra directories to look for device crash logs in, besides the platform's default ones
+void Settings::setCrashLogDirectories(const QStringList &paths) {
+    qsSettings->setValue(QLatin1String("CrashLogs/Directories"), paths);
+}
+
+// Get extra directories to look for device crash logs in, besides the platform's default ones
+QStringList Settings::crashLogDirectories() {
+    return qsSettings->value(QLatin1String("CrashLogs/Directories")).toStringList();
+}
+
+// Set the names of the apps whose crash logs we're interested in
+void Settings::setCrashLogApplications(const QStringList &names) {
+    qsSettings->setValue(QLatin1String("CrashLogs/Applications"), names);
+}
+
+// Get the names of the apps whose crash logs we're interested in
+QStringList Settings::crashLogApplications() {
+    QStringList names = qsSettings->value(QLatin1String("CrashLogs/Applications"), QStringList() << QLatin1String("Mumble")).toStringList();
+    names.removeAll(QString());
+    if (names.isEmpty())
+        names << QLatin1String("Mumble");
+    return names;
+}
+
+// Set the upload bandwidth limit, in kilobytes per second. 0 means unlimited.
+void Settings::setUploadRateLimit(int kbps) {
+    qsSettings->setValue(QLatin1String("Network/Upload/RateLimit"), kbps);
+}
+
+// Get the upload bandwidth limit, in kilobytes per second. 0 means unlimited.
+int Settings::uploadRateLimit() {
+    return qMax(qsSettings->value(QLatin1String("Network/Upload/RateLimit"), 0).toInt(), 0);
+}
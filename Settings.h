@@ -49,6 +49,20 @@ public:
     void setProxyUsername(const QString &username);
     void setProxyPassword(const QString &password);
     void setVerboseJavaScriptErrors(bool b);
+    void setMaxConcurrentUploads(int n);
+    void setUploadServer(const QString &url);
+    void setBatchUploads(bool b);
+    void setBatchMaxLogs(int n);
+    void setBatchMaxBytes(int n);
+    void setCompressUploads(bool b);
+    void setNegotiateUploads(bool b);
+    void setUploadRepresentatives(bool b);
+    void setRepresentativesPerSignature(int n);
+    void setSymbolsDirectory(const QString &path);
+    void setPreviewCacheSize(int kb);
+    void setCrashLogDirectories(const QStringList &paths);
+    void setCrashLogApplications(const QStringList &names);
+    void setUploadRateLimit(int kbps);
 
     QByteArray mainWindowGeometry(const QByteArray &defaultVal = QByteArray());
     int proxyType();
@@ -57,6 +71,20 @@ public:
     QString proxyUsername();
     QString proxyPassword();
     bool verboseJavaScriptErrors();
+    int maxConcurrentUploads();
+    QString uploadServer();
+    bool batchUploads();
+    int batchMaxLogs();
+    int batchMaxBytes();
+    bool compressUploads();
+    bool negotiateUploads();
+    bool uploadRepresentatives();
+    int representativesPerSignature();
+    QString symbolsDirectory();
+    int previewCacheSize();
+    QStringList crashLogDirectories();
+    QStringList crashLogApplications();
+    int uploadRateLimit();
 
     void setupApplicationProxy();
     void apply();
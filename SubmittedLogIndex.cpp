@@ -0,0 +1,163 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SubmittedLogIndex.h"
+
+#include <QtGui/QtGui>
+
+#include <string.h>
+
+static const char IndexMagic[4] = { 'M', 'S', 'L', 'I' };
+static const quint32 IndexVersion = 1;
+static const int HeaderLength = 8;
+static const int HashLength = 20;
+
+SubmittedLogIndex::SubmittedLogIndex(const QString &path) {
+    qsPath = path;
+    load();
+}
+
+SubmittedLogIndex::~SubmittedLogIndex() {
+}
+
+// Get the path of the index file. It lives next to the submitted logs
+// directory (see LogHandler::submittedCrashLogDirectory()).
+QString SubmittedLogIndex::defaultIndexPath() {
+    QString path = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+    QDir d;
+    d.mkpath(path);
+    return QDir(path).absoluteFilePath(QLatin1String("SubmittedLogs.idx"));
+}
+
+// Compute the content hash of the file at 'path'. Returns an empty
+// QByteArray if the file could not be read.
+QByteArray SubmittedLogIndex::hashForFile(const QString &path) {
+    QFile f(path);
+    if (! f.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    while (! f.atEnd())
+        hash.addData(f.read(64 * 1024));
+    f.close();
+
+    return hash.result();
+}
+
+// Move an index we can't read out of the way, to '<path>.bad', so that the
+// next insert() starts a fresh one instead of appending to it.
+static void setIndexAside(QFile &f) {
+    f.close();
+    QString aside = f.fileName() + QLatin1String(".bad");
+    QFile::remove(aside);
+    if (! f.rename(aside) && ! f.remove())
+        qWarning("SubmittedLogIndex: Unable to move unreadable index aside.");
+}
+
+void SubmittedLogIndex::load() {
+    QFile f(qsPath);
+    if (! f.exists())
+        return;
+
+    if (! f.open(QIODevice::ReadOnly)) {
+        qWarning("SubmittedLogIndex: Unable to open index for reading.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[4];
+    quint32 version = 0;
+    if (qds.readRawData(magic, 4) != 4 || memcmp(magic, IndexMagic, 4) != 0) {
+        qWarning("SubmittedLogIndex: Index has bad magic. Setting it aside.");
+        setIndexAside(f);
+        return;
+    }
+    qds >> version;
+    if (version != IndexVersion) {
+        qWarning("SubmittedLogIndex: Unknown index version %u. Setting it aside.", version);
+        setIndexAside(f);
+        return;
+    }
+
+    QByteArray hash(HashLength, 0);
+    while (qds.readRawData(hash.data(), HashLength) == HashLength) {
+        qsetHashes.insert(hash);
+        hash = QByteArray(HashLength, 0);
+    }
+
+    f.close();
+
+    // A truncated trailing record (e.g. from a crash while appending) is
+    // cut off, so that the records appended after it stay aligned.
+    qint64 excess = (f.size() - HeaderLength) % HashLength;
+    if (excess > 0) {
+        qWarning("SubmittedLogIndex: Dropping truncated record at end of index.");
+        if (! f.resize(f.size() - excess))
+            qWarning("SubmittedLogIndex: Unable to truncate index.");
+    }
+}
+
+// Is the log with content hash 'hash' known to have been submitted?
+bool SubmittedLogIndex::contains(const QByteArray &hash) const {
+    return qsetHashes.contains(hash);
+}
+
+// Record that the log with content hash 'hash' has been submitted.
+// The hash is appended to the on-disk index right away.
+void SubmittedLogIndex::insert(const QByteArray &hash) {
+    if (hash.length() != HashLength || qsetHashes.contains(hash))
+        return;
+    qsetHashes.insert(hash);
+
+    QFile f(qsPath);
+    bool empty = (f.size() == 0);
+    if (! f.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning("SubmittedLogIndex: Unable to open index for writing.");
+        return;
+    }
+
+    QDataStream qds(&f);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+    if (empty) {
+        qds.writeRawData(IndexMagic, 4);
+        qds << IndexVersion;
+    }
+    qds.writeRawData(hash.constData(), HashLength);
+
+    f.close();
+}
+
+// Returns the number of hashes in the index.
+int SubmittedLogIndex::count() const {
+    return qsetHashes.count();
+}
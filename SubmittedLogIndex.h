@@ -0,0 +1,63 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __SUBMITTEDLOGINDEX_H__
+#define __SUBMITTEDLOGINDEX_H__
+
+#include <QtCore/QtCore>
+
+// A persistent index of the content hashes (SHA-1) of all crash logs that
+// have been submitted to the server. This lets us recognize logs that we've
+// already sent, even if iTunes syncs them to the computer again, or the user
+// restores them from the submitted logs directory.
+//
+// The index is an append-only file next to the submitted logs directory:
+//
+//   "MSLI"          (4 bytes, magic)
+//   quint32 version (currently 1, little endian)
+//   20 bytes hash   (repeated)
+//
+// It is loaded into a QSet on construction, so lookups are O(1).
+class SubmittedLogIndex {
+    protected:
+        QString qsPath;
+        QSet<QByteArray> qsetHashes;
+        void load();
+
+    public:
+        SubmittedLogIndex(const QString &path = SubmittedLogIndex::defaultIndexPath());
+        ~SubmittedLogIndex();
+        bool contains(const QByteArray &hash) const;
+        void insert(const QByteArray &hash);
+        int count() const;
+        static QString defaultIndexPath();
+        static QByteArray hashForFile(const QString &path);
+};
+
+#endif
@@ -0,0 +1,296 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "Symbolicator.h"
+#include "CrashLogParser.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <string.h>
+
+static const char SymbolMapMagic[4] = { 'M', 'S', 'Y', 'M' };
+static const quint32 SymbolMapVersion = 1;
+
+// The address at which iOS executables are linked, unless a text map
+// says otherwise.
+static const quint64 DefaultImageBase = 0x1000;
+
+QMutex Symbolicator::qmLock;
+QString Symbolicator::qsSymbolsDir;
+QHash<QByteArray, QSharedPointer<SymbolMap> > Symbolicator::qhMaps;
+
+SymbolMap::SymbolMap() {
+    iBase = DefaultImageBase;
+}
+
+// The address the image was linked at. Symbol addresses are relative to
+// this, rather than to where the image was loaded in the crashed process.
+quint64 SymbolMap::base() const {
+    return iBase;
+}
+
+int SymbolMap::count() const {
+    return qvAddresses.count();
+}
+
+// Load the map at 'path'. Binary maps are recognized by their magic;
+// anything else is read as a text map.
+bool SymbolMap::load(const QString &path) {
+    QFile f(path);
+    if (! f.open(QIODevice::ReadOnly))
+        return false;
+
+    char magic[4];
+    if (f.peek(magic, 4) == 4 && memcmp(magic, SymbolMapMagic, 4) == 0)
+        return loadBinary(&f);
+    return loadText(&f);
+}
+
+// Load a binary map. It is serialized with QDataStream in little endian
+// byte order:
+//
+//   "MSYM"                   (4 bytes, magic)
+//   quint32 version          (currently 1)
+//   quint64 base
+//   QVector<quint64>         symbol addresses, sorted
+//   QVector<quint32>         offsets of the symbol names in the string table
+//   QByteArray               string table, NUL-terminated names
+bool SymbolMap::loadBinary(QIODevice *dev) {
+    QDataStream qds(dev);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[4];
+    quint32 version = 0;
+    qds.readRawData(magic, 4);
+    qds >> version;
+    if (version != SymbolMapVersion) {
+        qWarning("SymbolMap: Unknown symbol map version %u.", version);
+        return false;
+    }
+
+    qds >> iBase >> qvAddresses >> qvNameOffsets >> qbaNames;
+    if (qds.status() != QDataStream::Ok || qvAddresses.count() != qvNameOffsets.count()) {
+        qWarning("SymbolMap: Symbol map is corrupt.");
+        return false;
+    }
+    foreach (quint32 offset, qvNameOffsets) {
+        if (offset >= static_cast<quint32>(qbaNames.size())) {
+            qWarning("SymbolMap: Symbol map is corrupt.");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Load a text map, as output by 'nm -n':
+//
+//   00001000 T __mh_execute_header
+//   00002a9c t -[AppDelegate applicationDidFinishLaunching:]
+//
+// Only text symbols are kept, and the leading underscore of C symbols is
+// dropped. A line reading 'base 0x...' sets the address the image was
+// linked at.
+bool SymbolMap::loadText(QIODevice *dev) {
+    QVector<QPair<quint64, quint32> > symbols;
+    QByteArray names;
+
+    while (! dev->atEnd()) {
+        QByteArray line = dev->readLine().trimmed();
+        if (line.startsWith("base ")) {
+            bool ok = false;
+            quint64 base = line.mid(5).trimmed().toULongLong(&ok, 0);
+            if (ok)
+                iBase = base;
+            continue;
+        }
+
+        int space = line.indexOf(' ');
+        if (space <= 0)
+            continue;
+        bool ok = false;
+        quint64 address = line.left(space).toULongLong(&ok, 16);
+        if (! ok)
+            continue;
+
+        QByteArray name = line.mid(space + 1).trimmed();
+        if (name.length() > 2 && name.at(1) == ' ') {
+            char type = name.at(0);
+            if (type != 'T' && type != 't')
+                continue;
+            name = name.mid(2).trimmed();
+        }
+        if (name.startsWith('_'))
+            name = name.mid(1);
+        if (name.isEmpty())
+            continue;
+
+        symbols.append(QPair<quint64, quint32>(address, static_cast<quint32>(names.size())));
+        names.append(name);
+        names.append('\0');
+    }
+
+    qSort(symbols.begin(), symbols.end());
+    qvAddresses.resize(symbols.count());
+    qvNameOffsets.resize(symbols.count());
+    for (int i = 0; i < symbols.count(); i++) {
+        qvAddresses[i] = symbols.at(i).first;
+        qvNameOffsets[i] = symbols.at(i).second;
+    }
+    qbaNames = names;
+    return ! qvAddresses.isEmpty();
+}
+
+// Find the symbol covering 'address' (relative to base()). Returns its name,
+// and its address in 'symbolAddress', or NULL if the address comes before
+// the first symbol.
+const char *SymbolMap::lookup(quint64 address, quint64 &symbolAddress) const {
+    QVector<quint64>::const_iterator it = std::upper_bound(qvAddresses.constBegin(), qvAddresses.constEnd(), address);
+    if (it == qvAddresses.constBegin())
+        return NULL;
+    --it;
+
+    symbolAddress = *it;
+    return qbaNames.constData() + qvNameOffsets.at(it - qvAddresses.constBegin());
+}
+
+// Normalize a build UUID as found in the Binary Images table: lower case,
+// without any dashes.
+QByteArray Symbolicator::normalizedUuid(const QByteArray &uuid) {
+    QByteArray normalized = uuid.toLower();
+    normalized.replace('-', QByteArray());
+    return normalized;
+}
+
+// Set the directory symbol maps are loaded from. Maps that have already
+// been loaded are kept, but images we found no map for are looked up again,
+// as the new directory may have one.
+void Symbolicator::setSymbolsDirectory(const QString &path) {
+    QMutexLocker lock(&qmLock);
+    qsSymbolsDir = path;
+
+    QHash<QByteArray, QSharedPointer<SymbolMap> >::iterator it = qhMaps.begin();
+    while (it != qhMaps.end()) {
+        if (it.value())
+            ++it;
+        else
+            it = qhMaps.erase(it);
+    }
+}
+
+// Get the symbol map for the image with build UUID 'uuid', loading it from
+// the symbols directory if it hasn't been loaded yet. Returns a null pointer
+// if there is no map for the image. Misses are remembered as null pointers,
+// so images without a map don't cost a trip to the file system every time.
+QSharedPointer<SymbolMap> Symbolicator::mapForUuid(const QByteArray &uuid) {
+    QByteArray key = normalizedUuid(uuid);
+    if (key.isEmpty())
+        return QSharedPointer<SymbolMap>();
+
+    QString dir;
+    {
+        QMutexLocker lock(&qmLock);
+        if (qhMaps.contains(key))
+            return qhMaps.value(key);
+        dir = qsSymbolsDir;
+    }
+    if (dir.isEmpty())
+        return QSharedPointer<SymbolMap>();
+
+    QDir d(dir);
+    QString name = QString::fromLatin1(key);
+    QString path = d.filePath(name + QLatin1String(".sym"));
+    if (! QFile::exists(path))
+        path = d.filePath(name + QLatin1String(".txt"));
+
+    // Load without holding the lock. Should another thread beat us to
+    // it, we use its map and throw ours away.
+    QSharedPointer<SymbolMap> map;
+    if (QFile::exists(path)) {
+        map = QSharedPointer<SymbolMap>(new SymbolMap());
+        if (! map->load(path)) {
+            qWarning("Symbolicator: Unable to load symbol map '%s'.", qPrintable(path));
+            map.clear();
+        }
+    }
+
+    QMutexLocker lock(&qmLock);
+    if (qhMaps.contains(key))
+        return qhMaps.value(key);
+    qhMaps.insert(key, map);
+    return map;
+}
+
+// Symbolicate the crashed thread's frames in 'summary', for each image we
+// have a symbol map for. Symbolicated frames read 'symbol + offset', just
+// like the ones symbolicated by Xcode. Returns the number of frames that
+// were symbolicated.
+int Symbolicator::symbolicate(CrashLogSummary &summary) {
+    if (summary.frames.isEmpty() || summary.images.isEmpty())
+        return 0;
+
+    // Images sorted by their load address, so the image containing a
+    // frame can be found by binary search.
+    QVector<QPair<quint64, int> > images(summary.images.count());
+    for (int i = 0; i < summary.images.count(); i++)
+        images[i] = QPair<quint64, int>(summary.images.at(i).base, i);
+    qSort(images.begin(), images.end());
+
+    QHash<int, QSharedPointer<SymbolMap> > maps;
+    int symbolicated = 0;
+    for (int i = 0; i < summary.frames.count(); i++) {
+        CrashLogFrame &frame = summary.frames[i];
+
+        QPair<quint64, int> key(frame.address, INT_MAX);
+        QVector<QPair<quint64, int> >::const_iterator it = std::upper_bound(images.constBegin(), images.constEnd(), key);
+        if (it == images.constBegin())
+            continue;
+        --it;
+
+        const CrashLogImage &image = summary.images.at(it->second);
+        if (frame.address > image.end)
+            continue;
+
+        if (! maps.contains(it->second))
+            maps.insert(it->second, mapForUuid(image.uuid));
+        QSharedPointer<SymbolMap> map = maps.value(it->second);
+        if (! map)
+            continue;
+
+        quint64 symbolAddress = 0;
+        quint64 address = frame.address - image.base + map->base();
+        const char *name = map->lookup(address, symbolAddress);
+        if (! name)
+            continue;
+
+        frame.symbol = QByteArray(name) + " + " + QByteArray::number(address - symbolAddress);
+        symbolicated++;
+    }
+    return symbolicated;
+}
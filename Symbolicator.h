@@ -0,0 +1,83 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __SYMBOLICATOR_H__
+#define __SYMBOLICATOR_H__
+
+#include <QtCore/QtCore>
+
+struct CrashLogSummary;
+
+// The symbols of a single build of an image, sorted by address.
+//
+// Addresses and name offsets are kept in two separate arrays, so that
+// a lookup only binary searches through a dense array of addresses. The
+// names themselves live NUL-terminated in a single string table.
+class SymbolMap {
+    protected:
+        quint64 iBase;
+        QVector<quint64> qvAddresses;
+        QVector<quint32> qvNameOffsets;
+        QByteArray qbaNames;
+        bool loadBinary(QIODevice *dev);
+        bool loadText(QIODevice *dev);
+
+    public:
+        SymbolMap();
+        bool load(const QString &path);
+        quint64 base() const;
+        int count() const;
+        const char *lookup(quint64 address, quint64 &symbolAddress) const;
+};
+
+// Offline symbolication of crash logs.
+//
+// Symbol maps are looked up by the build UUID of an image, as found in
+// the Binary Images table of a log, in the symbols directory (see
+// setSymbolsDirectory()). A map is either a binary map, <uuid>.sym, or
+// the output of 'nm -n' for the image, <uuid>.txt. Maps are loaded on
+// first use, and kept around for as long as the process lives; there are
+// only ever a handful of builds of our app.
+//
+// This is used from worker threads, so the map cache is guarded by a
+// mutex. Maps themselves are never modified once loaded.
+class Symbolicator {
+    protected:
+        static QMutex qmLock;
+        static QString qsSymbolsDir;
+        static QHash<QByteArray, QSharedPointer<SymbolMap> > qhMaps;
+
+    public:
+        static void setSymbolsDirectory(const QString &path);
+        static QByteArray normalizedUuid(const QByteArray &uuid);
+        static QSharedPointer<SymbolMap> mapForUuid(const QByteArray &uuid);
+        static int symbolicate(CrashLogSummary &summary);
+};
+
+#endif
@@ -0,0 +1,139 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "UploadThrottle.h"
+
+UploadThrottle::UploadThrottle(QObject *p) : QObject(p) {
+    iRate = 0;
+    iTokens = 0;
+    qtRefilled.start();
+
+    qtWakeup = new QTimer(this);
+    qtWakeup->setSingleShot(true);
+    QObject::connect(qtWakeup, SIGNAL(timeout()), this, SIGNAL(tokensAvailable()));
+}
+
+// Set the rate in bytes per second. A rate of 0 turns the throttle off.
+void UploadThrottle::setRate(qint64 bytesPerSecond) {
+    bytesPerSecond = qMax(bytesPerSecond, Q_INT64_C(0));
+    if (bytesPerSecond == iRate)
+        return;
+
+    refill();
+    iRate = bytesPerSecond;
+    iTokens = qMin(iTokens, iRate);
+
+    // Waiting readers may be able to go on right away.
+    if (qtWakeup->isActive() || iRate == 0) {
+        qtWakeup->stop();
+        emit tokensAvailable();
+    }
+}
+
+qint64 UploadThrottle::rate() const {
+    return iRate;
+}
+
+// Add the tokens that have accumulated since the last refill. Only the
+// time that went into whole tokens is used up, so frequent refills at a
+// low rate don't lose the fractions in between.
+void UploadThrottle::refill() {
+    int elapsed = qtRefilled.elapsed();
+    if (iRate == 0 || elapsed <= 0)
+        return;
+
+    qint64 gained = iRate * elapsed / 1000;
+    if (gained == 0)
+        return;
+
+    iTokens += gained;
+    if (iTokens >= iRate) {
+        iTokens = iRate;
+        qtRefilled.restart();
+    } else {
+        qtRefilled = qtRefilled.addMSecs(static_cast<int>(gained * 1000 / iRate));
+    }
+}
+
+// Take up to 'wanted' tokens out of the bucket, and return how many were
+// taken. If none could be taken, tokensAvailable() is emitted once the
+// bucket has filled up a bit.
+qint64 UploadThrottle::take(qint64 wanted) {
+    if (iRate == 0)
+        return wanted;
+
+    refill();
+    qint64 taken = qMin(wanted, iTokens);
+    iTokens -= taken;
+
+    if (taken == 0 && ! qtWakeup->isActive()) {
+        // Wait for a reasonably sized slice, rather than waking up for
+        // every few bytes.
+        qint64 slice = qBound(Q_INT64_C(1), qMin(wanted, iRate / 10), iRate);
+        qtWakeup->start(static_cast<int>(qMax(Q_INT64_C(10), slice * 1000 / iRate)));
+    }
+    return taken;
+}
+
+ThrottledUploadDevice::ThrottledUploadDevice(QIODevice *file, UploadThrottle *throttle, QObject *p) : QIODevice(p) {
+    qiodFile = file;
+    qiodFile->setParent(this);
+    utThrottle = throttle;
+    QObject::connect(throttle, SIGNAL(tokensAvailable()), this, SIGNAL(readyRead()));
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+qint64 ThrottledUploadDevice::size() const {
+    return qiodFile->size();
+}
+
+bool ThrottledUploadDevice::seek(qint64 pos) {
+    if (! qiodFile->seek(pos))
+        return false;
+    return QIODevice::seek(pos);
+}
+
+bool ThrottledUploadDevice::atEnd() const {
+    return qiodFile->atEnd();
+}
+
+qint64 ThrottledUploadDevice::readData(char *data, qint64 maxSize) {
+    if (qiodFile->atEnd())
+        return 0;
+
+    qint64 allowed = utThrottle ? utThrottle->take(maxSize) : maxSize;
+    if (allowed == 0)
+        return 0;
+
+    return qiodFile->read(data, allowed);
+}
+
+qint64 ThrottledUploadDevice::writeData(const char *, qint64) {
+    return -1;
+}
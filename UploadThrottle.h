@@ -0,0 +1,85 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __UPLOADTHROTTLE_H__
+#define __UPLOADTHROTTLE_H__
+
+#include <QtCore/QtCore>
+
+// A token bucket, shared by all uploads, that caps the rate at which
+// request bodies are handed to the network.
+//
+// The bucket fills up at the configured rate, and holds at most one
+// second's worth of tokens, so an idle period doesn't turn into a burst
+// afterwards. A rate of 0 turns the throttle off.
+class UploadThrottle : public QObject {
+        Q_OBJECT
+
+    public:
+        UploadThrottle(QObject *p = NULL);
+        void setRate(qint64 bytesPerSecond);
+        qint64 rate() const;
+        qint64 take(qint64 wanted);
+
+    protected:
+        qint64 iRate;
+        qint64 iTokens;
+        QTime qtRefilled;
+        QTimer *qtWakeup;
+        void refill();
+
+    signals:
+        // Emitted when tokens have become available after a take()
+        // came back empty-handed.
+        void tokensAvailable();
+};
+
+// A read-only device for an upload body, which only gives out as many
+// bytes as the throttle allows. When the bucket is empty, reads return
+// nothing, and readyRead() is emitted once there are tokens again; the
+// network code waits for it before reading on.
+//
+// The device takes ownership of 'file', which must already be open.
+class ThrottledUploadDevice : public QIODevice {
+        Q_OBJECT
+
+    public:
+        ThrottledUploadDevice(QIODevice *file, UploadThrottle *throttle, QObject *p = NULL);
+        qint64 size() const;
+        bool seek(qint64 pos);
+        bool atEnd() const;
+
+    protected:
+        QIODevice *qiodFile;
+        QPointer<UploadThrottle> utThrottle;
+        qint64 readData(char *data, qint64 maxSize);
+        qint64 writeData(const char *data, qint64 maxSize);
+};
+
+#endif
@@ -30,6 +30,7 @@
 
 #include <QtGui/QApplication>
 #include "CrashReporter.h"
+#include "CommandLineSubmitter.h"
 #ifdef Q_OS_WIN
 # include <windows.h>
 #endif
@@ -86,6 +87,21 @@ static void setupLogging() {
 int main(int argc, char *argv[]) {
     QT_REQUIRE_VERSION(argc, argv, "4.6.0");
 
+    // Without a window, skip setting up the GUI (and WebKit) entirely.
+    CommandLineSubmitter::Mode mode = CommandLineSubmitter::modeForArguments(argc, argv);
+    if (mode != CommandLineSubmitter::None) {
+        QCoreApplication a(argc, argv);
+        a.setApplicationName(QLatin1String("MumbleiOSBetaCrashReporter"));
+        a.setApplicationVersion(QLatin1String("1.2.1"));
+        a.setOrganizationName(QLatin1String("Mumble"));
+        a.setOrganizationDomain(QLatin1String("mumble.info"));
+
+        setupLogging();
+
+        CommandLineSubmitter cls(mode);
+        return cls.run();
+    }
+
     QApplication a(argc, argv);
     a.setApplicationName(QLatin1String("MumbleiOSBetaCrashReporter"));
     a.setApplicationVersion(QLatin1String("1.2.1"));
@@ -6,6 +6,12 @@ TEMPLATE = app
 win32 {
 	RC_FILE = mumble-ios-crashreporter.rc
 	QMAKE_LIBS += user32.lib
+	# Use the zlib that is built into QtCore.
+	INCLUDEPATH += $$[QT_INSTALL_PREFIX]/src/3rdparty/zlib
+}
+
+unix {
+    LIBS += -lz
 }
 
 macx {
@@ -23,7 +29,18 @@ SOURCES += \
     LogHandler.cpp \
     ConfigDialog.cpp \
     Settings.cpp \
-    CrashWebPage.cpp
+    CrashWebPage.cpp \
+    CompressionHelper.cpp \
+    SubmittedLogIndex.cpp \
+    RetryQueue.cpp \
+    CrashLogManifest.cpp \
+    CrashLogParser.cpp \
+    Symbolicator.cpp \
+    CrashLogSearchIndex.cpp \
+    CrashLogCatalog.cpp \
+    CrashFileChunkReader.cpp \
+    CommandLineSubmitter.cpp \
+    UploadThrottle.cpp
 
 HEADERS += \
     CrashReporter.h \
@@ -32,7 +49,19 @@ HEADERS += \
     LogHandler.h \
     ConfigDialog.h \
     Settings.h \
-    CrashWebPage.h
+    CrashWebPage.h \
+    CompressionHelper.h \
+    SubmittedLogIndex.h \
+    RetryQueue.h \
+    DeviceLog.h \
+    CrashLogManifest.h \
+    CrashLogParser.h \
+    Symbolicator.h \
+    CrashLogSearchIndex.h \
+    CrashLogCatalog.h \
+    CrashFileChunkReader.h \
+    CommandLineSubmitter.h \
+    UploadThrottle.h
 
 FORMS += \
     CrashReporter.ui \
@@ -0,0 +1,18 @@
+QT -= gui
+QT += network
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = crashserver
+TEMPLATE = app
+
+win32 {
+	# Use the zlib that is built into QtCore.
+	INCLUDEPATH += $$[QT_INSTALL_PREFIX]/src/3rdparty/zlib
+}
+
+unix {
+    LIBS += -lz
+}
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,519 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * crashserver -- a local stand-in for the crash reporter server, for trying
+ * out the upload protocol offline.
+ *
+ * Usage: crashserver [options] <storage directory>
+ *
+ *   --port <port>        Port to listen on, on localhost (default 8080).
+ *   --fail-every <n>     Report every n-th log received as failed, to
+ *                        exercise the client's per-log error handling.
+ *   --dictionary <file>  Preset dictionary to inflate uploads with, as
+ *                        built by mkcrashdict. May be given more than
+ *                        once, to accept uploads from clients shipped
+ *                        with older dictionaries. Uploads compressed
+ *                        against a dictionary we don't have are refused
+ *                        with 415.
+ *   --no-deflate         Refuse all compressed uploads with 415, as a
+ *                        server without compression support would.
+ *   --have <mode>        How to answer /crashreporter/have: 'on' (the
+ *                        default), 'off' to answer 404 like a server
+ *                        without the endpoint, or 'broken' to answer 200
+ *                        with an HTML page, like a misconfigured one.
+ *   --delay <ms>         Hold every reply back this long. Logs are stored
+ *                        right away, so cancelling a submit while uploads
+ *                        are in flight leaves logs that the server has but
+ *                        the client doesn't know it has.
+ *
+ * Point the client at it by setting Network/Upload/Server to
+ * http://localhost:8080 in its settings, and submit as usual (or run it
+ * with --submit-all). Network/Upload/Batch turns on batched uploads.
+ *
+ * Endpoints:
+ *
+ *   POST /crashreporter/send       A single crash log. Replies 200.
+ *   POST /crashreporter/sendbatch  A batch of crash logs, in the container
+ *                                  format described at
+ *                                  LogHandler::prepareUploadBody(). Replies
+ *                                  with one line per entry, 'OK' or 'ERR'.
+ *   POST /crashreporter/have       Hex-encoded SHA-1 hashes of logs, one per
+ *                                  line. Replies with the hashes of those we
+ *                                  haven't stored yet, one per line, and an
+ *                                  'X-Crash-Have: 1' header.
+ *
+ * Bodies sent with 'Content-Encoding: deflate' are inflated first, against
+ * the dictionary named by X-Crash-Dictionary-Id if the stream asks for one.
+ * Bodies that don't inflate are refused with 400. Either way, the client
+ * should step down to a simpler encoding and send them again.
+ *
+ * Logs received are stored as <storage directory>/<device>/<file>; single
+ * logs, which carry no names, go into an 'unnamed' device directory. Logs
+ * already in the storage directory when the server starts count as stored
+ * for /have. Each request is logged to stdout.
+ */
+
+#include <QtCore/QtCore>
+#include <QtNetwork/QtNetwork>
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+enum HaveMode { HaveOn, HaveOff, HaveBroken };
+
+struct HttpRequest {
+    QByteArray method;
+    QByteArray path;
+    QHash<QByteArray, QByteArray> headers;
+    QByteArray body;
+};
+
+struct HttpResponse {
+    int status;
+    QList<QPair<QByteArray, QByteArray> > headers;
+    QByteArray body;
+
+    HttpResponse(int s = 200, const QByteArray &b = QByteArray()) : status(s), body(b) {
+    }
+};
+
+class CrashServer : public QObject {
+        Q_OBJECT
+
+    protected:
+        QTcpServer *qtsServer;
+        QDir qdStorage;
+        QHash<QTcpSocket *, QByteArray> qhBuffers;
+        int iFailEvery;
+        int iReceived;
+        bool bDeflate;
+        QHash<QByteArray, QByteArray> qhDictionaries;
+        HaveMode hmHave;
+        QSet<QByteArray> qsetHashes;
+        int iDelay;
+        QList<QPair<QPointer<QTcpSocket>, HttpResponse> > qlDelayed;
+
+        HttpResponse handle(const HttpRequest &req);
+        int decodeBody(const HttpRequest &req, QByteArray &body);
+        HttpResponse handleSend(const HttpRequest &req);
+        HttpResponse handleSendBatch(const HttpRequest &req);
+        HttpResponse handleHave(const HttpRequest &req);
+        bool storeLog(const QString &device, const QString &file, const QByteArray &data);
+        void writeResponse(QTcpSocket *sock, const HttpResponse &res);
+
+    public:
+        CrashServer(const QString &storageDir, int failEvery);
+        void setDeflate(bool b);
+        QByteArray addDictionary(const QByteArray &dictionary);
+        void setHaveMode(HaveMode mode);
+        void setDelay(int msec);
+        int loadStoredLogs();
+        bool listen(quint16 port);
+
+    protected slots:
+        void newConnection();
+        void readyRead();
+        void disconnected();
+        void writeDelayedResponse();
+};
+
+CrashServer::CrashServer(const QString &storageDir, int failEvery) : qdStorage(storageDir) {
+    qtsServer = new QTcpServer(this);
+    iFailEvery = failEvery;
+    iReceived = 0;
+    bDeflate = true;
+    hmHave = HaveOn;
+    iDelay = 0;
+    QObject::connect(qtsServer, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+void CrashServer::setDeflate(bool b) {
+    bDeflate = b;
+}
+
+// Use 'dictionary' to inflate uploads compressed against it. Its ID is the
+// Adler-32 checksum, as hex, just like the client computes it. Returns the ID.
+QByteArray CrashServer::addDictionary(const QByteArray &dictionary) {
+    uLong adler = adler32(0L, Z_NULL, 0);
+    adler = adler32(adler, reinterpret_cast<const Bytef *>(dictionary.constData()), dictionary.length());
+    QByteArray id = QString::fromLatin1("%1").arg(static_cast<quint32>(adler), 8, 16, QLatin1Char('0')).toLatin1();
+    qhDictionaries.insert(id, dictionary);
+    return id;
+}
+
+void CrashServer::setHaveMode(HaveMode mode) {
+    hmHave = mode;
+}
+
+void CrashServer::setDelay(int msec) {
+    iDelay = msec;
+}
+
+// Remember the hashes of the logs already in the storage directory, so
+// /have knows about them. Returns the number of logs found.
+int CrashServer::loadStoredLogs() {
+    QDirIterator iter(qdStorage.path(), QDir::Files, QDirIterator::Subdirectories);
+    while (iter.hasNext()) {
+        QFile f(iter.next());
+        if (f.open(QIODevice::ReadOnly))
+            qsetHashes.insert(QCryptographicHash::hash(f.readAll(), QCryptographicHash::Sha1));
+    }
+    return qsetHashes.count();
+}
+
+bool CrashServer::listen(quint16 port) {
+    return qtsServer->listen(QHostAddress::LocalHost, port);
+}
+
+void CrashServer::newConnection() {
+    while (qtsServer->hasPendingConnections()) {
+        QTcpSocket *sock = qtsServer->nextPendingConnection();
+        qhBuffers.insert(sock, QByteArray());
+        QObject::connect(sock, SIGNAL(readyRead()), this, SLOT(readyRead()));
+        QObject::connect(sock, SIGNAL(disconnected()), this, SLOT(disconnected()));
+    }
+}
+
+void CrashServer::disconnected() {
+    QTcpSocket *sock = static_cast<QTcpSocket *>(sender());
+    qhBuffers.remove(sock);
+    sock->deleteLater();
+}
+
+// Collect data until a whole request (headers and Content-Length bytes of
+// body) has arrived, and answer it. Connections are kept alive, so there may
+// be several requests, one after another, on the same socket.
+void CrashServer::readyRead() {
+    QTcpSocket *sock = static_cast<QTcpSocket *>(sender());
+    QByteArray &buffer = qhBuffers[sock];
+    buffer.append(sock->readAll());
+
+    forever {
+        int headerEnd = buffer.indexOf("\r\n\r\n");
+        if (headerEnd < 0)
+            return;
+
+        HttpRequest req;
+        QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+        QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+        if (requestLine.count() < 2) {
+            writeResponse(sock, HttpResponse(400));
+            sock->disconnectFromHost();
+            return;
+        }
+        req.method = requestLine.at(0);
+        req.path = requestLine.at(1);
+        foreach (QByteArray line, lines) {
+            int colon = line.indexOf(':');
+            if (colon > 0)
+                req.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+        }
+
+        int length = req.headers.value("content-length").toInt();
+        if (buffer.length() < headerEnd + 4 + length)
+            return;
+        req.body = buffer.mid(headerEnd + 4, length);
+        buffer.remove(0, headerEnd + 4 + length);
+
+        HttpResponse res = handle(req);
+        printf("crashserver: %s %s (%i bytes) -> %i\n", req.method.constData(), req.path.constData(), length, res.status);
+        fflush(stdout);
+        if (iDelay > 0) {
+            // Every reply is held back equally long, so they go out in
+            // the order their requests came in.
+            qlDelayed << QPair<QPointer<QTcpSocket>, HttpResponse>(sock, res);
+            QTimer::singleShot(iDelay, this, SLOT(writeDelayedResponse()));
+        } else {
+            writeResponse(sock, res);
+        }
+    }
+}
+
+// Send the oldest reply held back by --delay, unless the client has hung
+// up on it in the meantime.
+void CrashServer::writeDelayedResponse() {
+    if (qlDelayed.isEmpty())
+        return;
+    QPair<QPointer<QTcpSocket>, HttpResponse> delayed = qlDelayed.takeFirst();
+    if (delayed.first && delayed.first->state() == QAbstractSocket::ConnectedState)
+        writeResponse(delayed.first, delayed.second);
+    else
+        printf("crashserver: client went away before its reply was sent\n");
+    fflush(stdout);
+}
+
+void CrashServer::writeResponse(QTcpSocket *sock, const HttpResponse &res) {
+    QByteArray out;
+    out.append("HTTP/1.1 " + QByteArray::number(res.status) + (res.status == 200 ? " OK" : " Error") + "\r\n");
+    out.append("Content-Type: text/plain\r\n");
+    out.append("Content-Length: " + QByteArray::number(res.body.length()) + "\r\n");
+    for (int i = 0; i < res.headers.count(); i++)
+        out.append(res.headers.at(i).first + ": " + res.headers.at(i).second + "\r\n");
+    out.append("\r\n");
+    out.append(res.body);
+    sock->write(out);
+}
+
+HttpResponse CrashServer::handle(const HttpRequest &req) {
+    if (req.method != "POST")
+        return HttpResponse(405);
+    if (req.path == "/crashreporter/have")
+        return handleHave(req);
+    if (req.path != "/crashreporter/send" && req.path != "/crashreporter/sendbatch")
+        return HttpResponse(404);
+
+    HttpRequest decoded = req;
+    int status = decodeBody(req, decoded.body);
+    if (status != 200)
+        return HttpResponse(status);
+
+    if (req.path == "/crashreporter/send")
+        return handleSend(decoded);
+    return handleSendBatch(decoded);
+}
+
+// Undo the Content-Encoding of the body of 'req', into 'body'. Returns 200
+// on success, 415 for encodings (or dictionaries) we don't support, and 400
+// for bodies that don't decode.
+int CrashServer::decodeBody(const HttpRequest &req, QByteArray &body) {
+    QByteArray encoding = req.headers.value("content-encoding").toLower();
+    if (encoding.isEmpty() || encoding == "identity") {
+        body = req.body;
+        return 200;
+    }
+    if (encoding != "deflate" || ! bDeflate)
+        return 415;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK)
+        return 500;
+
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(req.body.constData()));
+    zs.avail_in = req.body.length();
+
+    body.clear();
+    char buffer[64 * 1024];
+    int ret;
+    do {
+        zs.next_out = reinterpret_cast<Bytef *>(buffer);
+        zs.avail_out = sizeof(buffer);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        if (ret == Z_NEED_DICT) {
+            QByteArray id = req.headers.value("x-crash-dictionary-id").toLower();
+            if (! qhDictionaries.contains(id) || zs.adler != id.toULong(NULL, 16)) {
+                inflateEnd(&zs);
+                return 415;
+            }
+            const QByteArray &dictionary = qhDictionaries[id];
+            ret = inflateSetDictionary(&zs, reinterpret_cast<const Bytef *>(dictionary.constData()), dictionary.length());
+            if (ret != Z_OK)
+                break;
+            continue;
+        }
+        body.append(buffer, sizeof(buffer) - zs.avail_out);
+    } while (ret == Z_OK);
+    inflateEnd(&zs);
+
+    if (ret != Z_STREAM_END) {
+        printf("crashserver:   body does not inflate (zlib error %i)\n", ret);
+        return 400;
+    }
+    printf("crashserver:   inflated %i bytes to %i bytes%s\n", req.body.length(), body.length(), req.headers.contains("x-crash-dictionary-id") ? " with dictionary" : "");
+    return 200;
+}
+
+// Store a crash log below the storage directory. Names are reduced to their
+// last path component, so a request can't write outside of it. Every n-th
+// log is refused, if asked to with --fail-every.
+bool CrashServer::storeLog(const QString &device, const QString &file, const QByteArray &data) {
+    ++iReceived;
+    if (iFailEvery > 0 && iReceived % iFailEvery == 0) {
+        printf("crashserver:   failing %s/%s as asked\n", qPrintable(device), qPrintable(file));
+        return false;
+    }
+
+    QString deviceName = QFileInfo(device).fileName();
+    QString fileName = QFileInfo(file).fileName();
+    if (deviceName.isEmpty() || deviceName.startsWith(QLatin1Char('.')) || fileName.isEmpty() || fileName.startsWith(QLatin1Char('.')))
+        return false;
+
+    if (! qdStorage.mkpath(deviceName))
+        return false;
+    QFile f(qdStorage.filePath(deviceName + QLatin1Char('/') + fileName));
+    if (! f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(data) != data.length())
+        return false;
+    f.close();
+    qsetHashes.insert(QCryptographicHash::hash(data, QCryptographicHash::Sha1));
+
+    printf("crashserver:   stored %s/%s (%i bytes)\n", qPrintable(deviceName), qPrintable(fileName), data.length());
+    return true;
+}
+
+HttpResponse CrashServer::handleSend(const HttpRequest &req) {
+    QString file = QString::fromLatin1("%1-%2.crash").arg(QDateTime::currentDateTime().toString(QLatin1String("yyyyMMdd-hhmmss"))).arg(iReceived + 1);
+    if (! storeLog(QLatin1String("unnamed"), file, req.body))
+        return HttpResponse(500);
+    return HttpResponse(200);
+}
+
+// Unpack a batch, and reply with one line per entry. A malformed container
+// is refused as a whole.
+HttpResponse CrashServer::handleSendBatch(const HttpRequest &req) {
+    QDataStream qds(req.body);
+    qds.setVersion(QDataStream::Qt_4_6);
+    qds.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[4];
+    quint32 version = 0, count = 0;
+    if (qds.readRawData(magic, 4) != 4 || memcmp(magic, "MCRB", 4) != 0)
+        return HttpResponse(400, "Bad batch magic\n");
+    qds >> version >> count;
+    if (qds.status() != QDataStream::Ok || version != 1)
+        return HttpResponse(400, "Unsupported batch version\n");
+
+    QByteArray status;
+    for (quint32 i = 0; i < count; i++) {
+        QByteArray fields[3];
+        for (int j = 0; j < 3; j++) {
+            quint32 len = 0;
+            qds >> len;
+            if (qds.status() != QDataStream::Ok || len > static_cast<quint32>(req.body.length()))
+                return HttpResponse(400, "Truncated batch\n");
+            fields[j].resize(len);
+            if (qds.readRawData(fields[j].data(), len) != static_cast<int>(len))
+                return HttpResponse(400, "Truncated batch\n");
+        }
+        bool ok = storeLog(QString::fromUtf8(fields[0]), QString::fromUtf8(fields[1]), fields[2]);
+        status.append(ok ? "OK\n" : "ERR\n");
+    }
+    return HttpResponse(200, status);
+}
+
+// Reply with the hashes in the request that we don't have a log for.
+HttpResponse CrashServer::handleHave(const HttpRequest &req) {
+    if (hmHave == HaveOff)
+        return HttpResponse(404);
+    if (hmHave == HaveBroken)
+        return HttpResponse(200, "<html><body>It works!</body></html>\n");
+
+    QByteArray wanted;
+    int asked = 0;
+    foreach (QByteArray line, req.body.split('\n')) {
+        line = line.trimmed().toLower();
+        if (line.isEmpty())
+            continue;
+        if (line.length() != 40)
+            return HttpResponse(400, "Bad hash\n");
+        ++asked;
+        if (! qsetHashes.contains(QByteArray::fromHex(line)))
+            wanted.append(line + '\n');
+    }
+
+    printf("crashserver:   asked about %i logs, want %i\n", asked, wanted.count('\n'));
+    HttpResponse res(200, wanted);
+    res.headers << qMakePair(QByteArray("X-Crash-Have"), QByteArray("1"));
+    return res;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+
+    quint16 port = 8080;
+    int failEvery = 0;
+    bool deflate = true;
+    HaveMode have = HaveOn;
+    int delay = 0;
+    QStringList dictionaryPaths;
+    QString storageDir;
+    bool usage = false;
+    for (int i = 1; i < args.count(); i++) {
+        const QString &arg = args.at(i);
+        bool hasValue = (i + 1 < args.count());
+        if (arg == QLatin1String("--port") && hasValue) {
+            port = static_cast<quint16>(args.at(++i).toUInt());
+        } else if (arg == QLatin1String("--fail-every") && hasValue) {
+            failEvery = args.at(++i).toInt();
+        } else if (arg == QLatin1String("--dictionary") && hasValue) {
+            dictionaryPaths << args.at(++i);
+        } else if (arg == QLatin1String("--delay") && hasValue) {
+            delay = args.at(++i).toInt();
+        } else if (arg == QLatin1String("--no-deflate")) {
+            deflate = false;
+        } else if (arg == QLatin1String("--have") && hasValue) {
+            QString mode = args.at(++i);
+            if (mode == QLatin1String("on"))
+                have = HaveOn;
+            else if (mode == QLatin1String("off"))
+                have = HaveOff;
+            else if (mode == QLatin1String("broken"))
+                have = HaveBroken;
+            else
+                usage = true;
+        } else if (storageDir.isEmpty() && ! arg.startsWith(QLatin1String("--"))) {
+            storageDir = arg;
+        } else {
+            usage = true;
+        }
+    }
+
+    if (usage || storageDir.isEmpty()) {
+        fprintf(stderr, "Usage: crashserver [--port <port>] [--fail-every <n>] [--dictionary <file>] [--no-deflate] [--have on|off|broken] [--delay <ms>] <storage directory>\n");
+        return 1;
+    }
+
+    QDir().mkpath(storageDir);
+    CrashServer server(storageDir, failEvery);
+    server.setDeflate(deflate);
+    server.setHaveMode(have);
+    server.setDelay(delay);
+    foreach (QString dictionaryPath, dictionaryPaths) {
+        QFile f(dictionaryPath);
+        if (! f.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "crashserver: unable to read dictionary %s\n", qPrintable(dictionaryPath));
+            return 1;
+        }
+        QByteArray id = server.addDictionary(f.readAll());
+        printf("crashserver: dictionary %s has id %s\n", qPrintable(dictionaryPath), id.constData());
+    }
+    int stored = server.loadStoredLogs();
+    if (! server.listen(port)) {
+        fprintf(stderr, "crashserver: unable to listen on port %u\n", port);
+        return 1;
+    }
+    printf("crashserver: listening on http://localhost:%u/, storing logs in %s (%i already there)\n", port, qPrintable(storageDir), stored);
+    fflush(stdout);
+
+    return a.exec();
+}
+
+#include "main.moc"
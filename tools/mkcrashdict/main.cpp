@@ -0,0 +1,235 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * mkcrashdict -- build the preset deflate dictionary used for crash log uploads.
+ *
+ * Usage: mkcrashdict [--seed <file>] <output file> [<corpus directory> ...]
+ *
+ * Every *.crash and *.ips file below the corpus directories is split into lines. Hex
+ * addresses (which differ between processes because of ASLR) are cut out of
+ * each line, and the remaining fragments are counted once per log they appear
+ * in. Fragments that are common across many logs (Binary Images entries,
+ * system framework frames, header field names) are then packed into the
+ * dictionary, most valuable last, since zlib can reference the end of the
+ * dictionary with the shortest distances.
+ *
+ * The result should be copied to crashlog_dictionary.dat in the top-level
+ * source directory. The dictionary ID printed at the end is what the client
+ * sends in the X-Crash-Dictionary-Id header; the server needs a copy of the
+ * dictionary with that ID to inflate uploads.
+ *
+ * --seed names a file of fragments, one per line, that go into the dictionary
+ * as they are, ahead of (and so at a lower priority than) anything taken from
+ * the corpus. It holds strings the line splitting above can't produce, such as
+ * the spacing around addresses in Binary Images entries. The checked-in
+ * crashlog_dictionary.dat is built from tools/mkcrashdict/seed.txt alone:
+ *
+ *   mkcrashdict --seed tools/mkcrashdict/seed.txt crashlog_dictionary.dat
+ *
+ * so it can be rebuilt byte for byte, and keeps its dictionary ID, until the
+ * seed or the corpus changes.
+ */
+
+#include <QtCore/QtCore>
+
+#include <stdio.h>
+#include <zlib.h>
+
+// zlib only ever looks at the last 32KB of a preset dictionary.
+static const int MaxDictionarySize = 32 * 1024;
+
+// Fragments shorter than this are cheap for deflate to encode anyway.
+static const int MinFragmentLength = 8;
+
+struct Fragment {
+    QByteArray text;
+    int logs;
+};
+
+static bool fragmentScoreLessThan(const Fragment &a, const Fragment &b) {
+    qint64 sa = static_cast<qint64>(a.logs) * a.text.length();
+    qint64 sb = static_cast<qint64>(b.logs) * b.text.length();
+    if (sa != sb)
+        return sa < sb;
+    return a.text < b.text;
+}
+
+// Split a line into the fragments that are left once hex addresses
+// and offsets have been cut out of it.
+static QList<QByteArray> fragmentsForLine(const QByteArray &line) {
+    static QRegExp address(QLatin1String("0x[0-9a-fA-F]+|\\+ [0-9]+"));
+    QList<QByteArray> fragments;
+    QString str = QString::fromUtf8(line.constData(), line.length());
+    int pos = 0;
+    while (pos < str.length()) {
+        int match = address.indexIn(str, pos);
+        int end = (match == -1) ? str.length() : match;
+        QByteArray fragment = str.mid(pos, end - pos).trimmed().toUtf8();
+        if (fragment.length() >= MinFragmentLength)
+            fragments << fragment;
+        if (match == -1)
+            break;
+        pos = match + address.matchedLength();
+    }
+    return fragments;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+
+    QString seedPath;
+    QString outputPath;
+    QStringList corpusDirs;
+    bool usage = false;
+    for (int i = 1; i < args.count(); i++) {
+        const QString &arg = args.at(i);
+        if (arg == QLatin1String("--seed") && i + 1 < args.count())
+            seedPath = args.at(++i);
+        else if (arg.startsWith(QLatin1String("--")))
+            usage = true;
+        else if (outputPath.isEmpty())
+            outputPath = arg;
+        else
+            corpusDirs << arg;
+    }
+
+    if (usage || outputPath.isEmpty() || (seedPath.isEmpty() && corpusDirs.isEmpty())) {
+        fprintf(stderr, "Usage: mkcrashdict [--seed <file>] <output file> [<corpus directory> ...]\n");
+        return 1;
+    }
+
+    // Seed fragments are kept verbatim and in order; only blank lines
+    // and repeats are dropped.
+    QList<QByteArray> seed;
+    QSet<QByteArray> seeded;
+    int seedSize = 0;
+    if (! seedPath.isEmpty()) {
+        QFile f(seedPath);
+        if (! f.open(QIODevice::ReadOnly)) {
+            fprintf(stderr, "mkcrashdict: unable to open %s\n", qPrintable(seedPath));
+            return 1;
+        }
+        while (! f.atEnd()) {
+            QByteArray text = f.readLine();
+            if (text.endsWith('\n'))
+                text.chop(1);
+            if (text.endsWith('\r'))
+                text.chop(1);
+            if (text.isEmpty() || seeded.contains(text))
+                continue;
+            seed << text;
+            seeded.insert(text);
+            seedSize += text.length() + 1;
+        }
+        f.close();
+
+        if (seedSize > MaxDictionarySize) {
+            fprintf(stderr, "mkcrashdict: seed is %i bytes, more than the %i bytes zlib uses\n", seedSize, MaxDictionarySize);
+            return 1;
+        }
+    }
+
+    // Count the number of logs each fragment appears in.
+    QHash<QByteArray, int> counts;
+    int nlogs = 0;
+    foreach (QString dir, corpusDirs) {
+        QDirIterator iter(dir, QStringList() << QLatin1String("*.crash") << QLatin1String("*.ips"), QDir::Files, QDirIterator::Subdirectories);
+        while (iter.hasNext()) {
+            QFile f(iter.next());
+            if (! f.open(QIODevice::ReadOnly)) {
+                fprintf(stderr, "mkcrashdict: unable to open %s\n", qPrintable(f.fileName()));
+                continue;
+            }
+
+            QSet<QByteArray> seen;
+            while (! f.atEnd()) {
+                foreach (QByteArray fragment, fragmentsForLine(f.readLine()))
+                    seen.insert(fragment);
+            }
+            f.close();
+
+            foreach (QByteArray fragment, seen)
+                counts[fragment] += 1;
+            ++nlogs;
+        }
+    }
+
+    if (nlogs == 0 && ! corpusDirs.isEmpty()) {
+        fprintf(stderr, "mkcrashdict: no crash logs found\n");
+        return 1;
+    }
+
+    // Only fragments that recur across logs are worth including.
+    QList<Fragment> fragments;
+    QHash<QByteArray, int>::const_iterator it;
+    for (it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        if (it.value() < 2 || seeded.contains(it.key()))
+            continue;
+        Fragment fragment;
+        fragment.text = it.key();
+        fragment.logs = it.value();
+        fragments << fragment;
+    }
+    qSort(fragments.begin(), fragments.end(), fragmentScoreLessThan);
+
+    // Take the best fragments that fit next to the seed, then lay them
+    // out after it, with the best ones at the end of the dictionary.
+    QList<QByteArray> chosen;
+    int size = seedSize;
+    for (int i = fragments.count() - 1; i >= 0; i--) {
+        const QByteArray &text = fragments.at(i).text;
+        if (size + text.length() + 1 > MaxDictionarySize)
+            continue;
+        chosen.prepend(text);
+        size += text.length() + 1;
+    }
+
+    chosen = seed + chosen;
+
+    QByteArray dictionary;
+    foreach (QByteArray text, chosen) {
+        dictionary.append(text);
+        dictionary.append('\n');
+    }
+
+    QFile out(outputPath);
+    if (! out.open(QIODevice::WriteOnly | QIODevice::Truncate) || out.write(dictionary) != dictionary.length()) {
+        fprintf(stderr, "mkcrashdict: unable to write %s\n", qPrintable(outputPath));
+        return 1;
+    }
+    out.close();
+
+    uLong adler = adler32(0L, Z_NULL, 0);
+    adler = adler32(adler, reinterpret_cast<const Bytef *>(dictionary.constData()), dictionary.length());
+    printf("mkcrashdict: %i logs, %i fragments, %i bytes, dictionary id %08lx\n", nlogs, chosen.count(), dictionary.length(), static_cast<unsigned long>(adler));
+
+    return 0;
+}
@@ -0,0 +1,256 @@
+/* Copyright (C) 2010 Mikkel Krautz <mikkel@krautz.dk>
+
+   All rights reserved.
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright notice,
+     this list of conditions and the following disclaimer.
+   - Redistributions in binary form must reproduce the above copyright notice,
+     this list of conditions and the following disclaimer in the documentation
+     and/or other materials provided with the distribution.
+   - Neither the name of the Mumble Developers nor the names of its
+     contributors may be used to endorse or promote products derived from this
+     software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * parsebench -- measure how fast crash logs are summarized.
+ *
+ * Usage: parsebench [--iterations <n>] <corpus directory> [<corpus directory> ...]
+ *
+ * Every *.crash and *.ips file below the corpus directories is summarized
+ * <n> times (default 10) in two ways:
+ *
+ *   parser  CrashLogParser::parseFile(), the single-pass parser used by
+ *           the client.
+ *   lines   For .crash logs, the way they used to be handled: the whole log
+ *           is decoded into a QString, split into lines, and the same fields
+ *           are picked out of those lines.
+ *   dom     For .ips reports, the obvious alternative to a streaming scan:
+ *           the JSON header and body are parsed into QVariant trees, through
+ *           QtScript, and the same fields are picked out of those.
+ *
+ * The files are read once before timing, so both run against a warm page
+ * cache. For each, the number of logs and megabytes per second is printed,
+ * along with how many logs had a crashed thread backtrace, as a sanity
+ * check that both found the same things.
+ */
+
+#include <QtCore/QtCore>
+#include <QtScript/QtScript>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "CrashLogParser.h"
+
+struct BenchResult {
+    int logs;
+    qint64 bytes;
+    int msecs;
+    int withFrames;
+};
+
+static void printResult(const char *kind, const char *method, const BenchResult &r) {
+    double secs = qMax(r.msecs, 1) / 1000.0;
+    printf("%-6s %-7s %8i logs %10.0f logs/s %8.1f MB/s %8i with backtrace\n",
+           kind, method, r.logs, r.logs / secs, r.bytes / secs / (1024.0 * 1024.0), r.withFrames);
+}
+
+// Summarize a .crash log the old way: decode all of it, split it into
+// lines, and match each line against the fields we're after.
+static int summarizeLines(const QString &path) {
+    QFile f(path);
+    if (! f.open(QIODevice::ReadOnly))
+        return 0;
+    QString contents = QString::fromUtf8(f.readAll());
+    f.close();
+
+    static const char *keys[] = {
+        "Incident Identifier:", "Hardware Model:", "OS Version:", "Version:",
+        "Date/Time:", "Exception Type:", "Exception Codes:", "Crashed Thread:"
+    };
+
+    QStringList header;
+    int frames = 0;
+    bool crashed = false;
+    foreach (QString line, contents.split(QLatin1Char('\n'))) {
+        line = line.trimmed();
+        if (line.isEmpty()) {
+            crashed = false;
+            continue;
+        }
+        if (line.startsWith(QLatin1String("Thread ")) && line.endsWith(QLatin1String(" Crashed:"))) {
+            crashed = true;
+            continue;
+        }
+        if (crashed) {
+            ++frames;
+            continue;
+        }
+        for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+            if (line.startsWith(QLatin1String(keys[i])))
+                header << line.mid(static_cast<int>(strlen(keys[i]))).trimmed();
+        }
+    }
+    return frames;
+}
+
+// Summarize an .ips report by parsing its JSON header and body into
+// QVariant trees.
+static int summarizeDom(QScriptEngine *engine, const QString &path) {
+    QFile f(path);
+    if (! f.open(QIODevice::ReadOnly))
+        return 0;
+    QString contents = QString::fromUtf8(f.readAll());
+    f.close();
+
+    int newline = contents.indexOf(QLatin1Char('\n'));
+    if (newline < 0)
+        return 0;
+    QVariantMap header = engine->evaluate(QLatin1Char('(') + contents.left(newline) + QLatin1Char(')')).toVariant().toMap();
+    QVariantMap body = engine->evaluate(QLatin1Char('(') + contents.mid(newline + 1) + QLatin1Char(')')).toVariant().toMap();
+
+    QStringList fields;
+    fields << header.value(QLatin1String("app_version")).toString()
+           << header.value(QLatin1String("os_version")).toString()
+           << body.value(QLatin1String("incident")).toString()
+           << body.value(QLatin1String("modelCode")).toString()
+           << body.value(QLatin1String("captureTime")).toString()
+           << body.value(QLatin1String("exception")).toMap().value(QLatin1String("type")).toString();
+
+    int frames = 0;
+    foreach (QVariant thread, body.value(QLatin1String("threads")).toList()) {
+        QVariantMap t = thread.toMap();
+        if (t.value(QLatin1String("triggered")).toBool())
+            frames = t.value(QLatin1String("frames")).toList().count();
+    }
+    return frames;
+}
+
+static BenchResult benchParser(const QStringList &paths, int iterations) {
+    BenchResult r = { 0, 0, 0, 0 };
+    QTime t;
+    t.start();
+    for (int i = 0; i < iterations; i++) {
+        foreach (QString path, paths) {
+            CrashLogSummary summary;
+            if (CrashLogParser::parseFile(path, summary) && ! summary.frames.isEmpty() && i == 0)
+                r.withFrames++;
+            r.logs++;
+        }
+    }
+    r.msecs = t.elapsed();
+    return r;
+}
+
+static BenchResult benchLines(const QStringList &paths, int iterations) {
+    BenchResult r = { 0, 0, 0, 0 };
+    QTime t;
+    t.start();
+    for (int i = 0; i < iterations; i++) {
+        foreach (QString path, paths) {
+            if (summarizeLines(path) > 0 && i == 0)
+                r.withFrames++;
+            r.logs++;
+        }
+    }
+    r.msecs = t.elapsed();
+    return r;
+}
+
+static BenchResult benchDom(const QStringList &paths, int iterations) {
+    BenchResult r = { 0, 0, 0, 0 };
+    QScriptEngine engine;
+    QTime t;
+    t.start();
+    for (int i = 0; i < iterations; i++) {
+        foreach (QString path, paths) {
+            if (summarizeDom(&engine, path) > 0 && i == 0)
+                r.withFrames++;
+            r.logs++;
+        }
+    }
+    r.msecs = t.elapsed();
+    return r;
+}
+
+// Find the files matching 'pattern' below 'dirs', and read each of them
+// once, so the page cache is warm. Returns the total size in 'bytes'.
+static QStringList findFiles(const QStringList &dirs, const QString &pattern, qint64 &bytes) {
+    QStringList paths;
+    bytes = 0;
+    foreach (QString dir, dirs) {
+        QDirIterator iter(dir, QStringList() << pattern, QDir::Files, QDirIterator::Subdirectories);
+        while (iter.hasNext()) {
+            QFile f(iter.next());
+            if (! f.open(QIODevice::ReadOnly))
+                continue;
+            bytes += f.readAll().length();
+            paths << f.fileName();
+        }
+    }
+    return paths;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+
+    int iterations = 10;
+    QStringList dirs;
+    for (int i = 1; i < args.count(); i++) {
+        if (args.at(i) == QLatin1String("--iterations") && i + 1 < args.count())
+            iterations = qMax(args.at(++i).toInt(), 1);
+        else
+            dirs << args.at(i);
+    }
+
+    if (dirs.isEmpty()) {
+        fprintf(stderr, "Usage: parsebench [--iterations <n>] <corpus directory> [<corpus directory> ...]\n");
+        return 1;
+    }
+
+    qint64 crashBytes = 0;
+    qint64 ipsBytes = 0;
+    QStringList crashLogs = findFiles(dirs, QLatin1String("*.crash"), crashBytes);
+    QStringList ipsLogs = findFiles(dirs, QLatin1String("*.ips"), ipsBytes);
+    if (crashLogs.isEmpty() && ipsLogs.isEmpty()) {
+        fprintf(stderr, "parsebench: no crash logs found\n");
+        return 1;
+    }
+
+    BenchResult r;
+    if (! crashLogs.isEmpty()) {
+        r = benchParser(crashLogs, iterations);
+        r.bytes = crashBytes * iterations;
+        printResult(".crash", "parser", r);
+        r = benchLines(crashLogs, iterations);
+        r.bytes = crashBytes * iterations;
+        printResult(".crash", "lines", r);
+    }
+    if (! ipsLogs.isEmpty()) {
+        r = benchParser(ipsLogs, iterations);
+        r.bytes = ipsBytes * iterations;
+        printResult(".ips", "parser", r);
+        r = benchDom(ipsLogs, iterations);
+        r.bytes = ipsBytes * iterations;
+        printResult(".ips", "dom", r);
+    }
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+QT -= gui
+QT += script
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = parsebench
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+HEADERS += \
+    ../../CrashLogParser.h
+
+SOURCES += \
+    main.cpp \
+    ../../CrashLogParser.cpp